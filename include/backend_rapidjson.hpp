@@ -7,6 +7,11 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstring>
+
+#include "rapidjson/reader.h"
+#include "rapidjson/memorystream.h"
 #include "rapidjson/document.h"
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
@@ -25,27 +30,43 @@ namespace static_json {
 
 }
 
-static std::unique_ptr<rapidjson::Document> document_;
-static rapidjson::Document::AllocatorType&
-	rapidjson_ugly_document_alloc() {
-	if (!document_)
-		document_.reset(new rapidjson::Document{ rapidjson::kObjectType });
-	return document_->GetAllocator();
-}
+namespace archive {
 
-static void set_default_ugly_document(rapidjson::Document* doc) {
-	document_.reset(doc);
-}
+	namespace detail {
 
-namespace archive {
+		// load_mode::update 解码映射后, 删除本次json中没有出现的key.
+		// seen为本次解码过的值的地址, 会被排序.
+		template <typename T>
+		void erase_unseen(T& container, const void** first, const void** last)
+		{
+			std::sort(first, last);
+			last = std::unique(first, last);
+			if (static_cast<std::size_t>(last - first) == container.size())
+				return;
+			for (auto it = container.begin(); it != container.end();)
+			{
+				if (std::binary_search(first, last, static_cast<const void*>(std::addressof(it->second))))
+					++it;
+				else
+					it = container.erase(it);
+			}
+		}
+	}
 
 	// rapidjson 到 普通数据结构.
 	//
 	struct rapidjson_iarchive
 	{
-		rapidjson_iarchive(const rapidjson::Value& json)
+		rapidjson_iarchive(const rapidjson::Value& json,
+			static_json::load_mode mode = static_json::load_mode::append,
+			std::pmr::memory_resource* resource = nullptr)
 			: json_(json)
-		{}
+			, mode_(mode)
+			, resource_(resource)
+		{
+			if (json_.IsObject())
+				next_ = json_.MemberBegin();
+		}
 
 		template <typename T>
 		rapidjson_iarchive& operator>>(static_json::nvp<T> const& wrap)
@@ -77,36 +98,67 @@ namespace archive {
 				value = json_.GetFloat();
 			else if constexpr (std::is_same_v<std::decay_t<T>, double>)
 				value = json_.GetDouble();
-			else if constexpr (std::is_same_v<std::decay_t<T>, std::string>)
+			else if constexpr (static_json::traits::is_string_v<T>)
 				value.assign(json_.GetString(), json_.GetStringLength());
+			else if constexpr (std::is_same_v<std::decay_t<T>, std::string_view>)
+				value = std::string_view(json_.GetString(), json_.GetStringLength());
+			else if constexpr (std::is_same_v<std::decay_t<T>, const char*>)
+				value = json_.GetString();
 			else if constexpr (static_json::traits::is_mapping_v<T>)
 			{
 				if (!json_.IsObject())
 					return *this;
+				std::vector<const void*> seen;
 				for (auto & o : json_.GetObject())
 				{
-					std::string key(o.name.GetString(), o.name.GetStringLength());
-					typename T::mapped_type v;
-					rapidjson_iarchive ja(o.value);
+					auto key = static_json::traits::make_with_resource<typename T::key_type>(
+						resource_, o.name.GetString(), o.name.GetStringLength());
+					auto& v = value[std::move(key)];
+					if (mode_ != static_json::load_mode::update)
+						v = typename T::mapped_type{};
+					else
+						seen.push_back(std::addressof(v));
+					rapidjson_iarchive ja(o.value, mode_, resource_);
 					ja >> v;
-					value[key] = v;
 				}
+				if (mode_ == static_json::load_mode::update)
+					detail::erase_unseen(value, seen.data(), seen.data() + seen.size());
 			}
 			else if constexpr (static_json::traits::is_std_optional_v<T>)
 			{
-				rapidjson_iarchive ja(json_);
-				typename T::value_type v;
-				ja >> v;
-				value = v;
+				if (json_.IsNull())
+				{
+					value.reset();
+					return *this;
+				}
+				if (mode_ != static_json::load_mode::update || !value)
+					value = static_json::traits::make_with_resource<typename T::value_type>(resource_);
+				rapidjson_iarchive ja(json_, mode_, resource_);
+				ja >> *value;
 			}
 			else if constexpr (static_json::traits::has_push_back<T>())
 			{
+				if (mode_ == static_json::load_mode::update)
+				{
+					// 按数组长度resize一次, 元素原地解码.
+					if constexpr (static_json::traits::is_resizable_random_access_v<T>)
+					{
+						value.resize(json_.Size());
+						for (rapidjson::SizeType i = 0; i < json_.Size(); i++)
+						{
+							rapidjson_iarchive ja(json_[i], mode_, resource_);
+							ja >> value[i];
+						}
+						return *this;
+					}
+					value.clear();
+				}
+				// 元素原地构造, 使用容器自身的分配器.
 				for (auto& a : json_.GetArray())
 				{
-					std::decay_t<typename T::value_type> tmp;
-					rapidjson_iarchive ja(a);
-					ja >> tmp;
-					value.push_back(tmp);
+					value.emplace_back();
+					rapidjson_iarchive ja(a, mode_, resource_);
+					ja >> value.back();
 				}
 			}
 			else
@@ -121,23 +173,27 @@ namespace archive {
 		}
 
 		template <typename T>
-		void load(char const* name, T& b) const
+		void load(char const* name, T& b)
 		{
-			if (!json_.HasMember(name))
+			auto member = find_member(name);
+			if (!member)
 				return;
 
-			auto& value = json_[name];
+			auto& value = *member;
 			switch (value.GetType())
 			{
 			case rapidjson::kNullType:
+				if constexpr (static_json::traits::is_std_optional_v<T>)
+					b.reset();
 				break;
 			case rapidjson::kObjectType:
 			{
 				if constexpr (!std::is_arithmetic_v<std::decay_t<T>>
-					&& !std::is_same_v<std::decay_t<T>, std::string>
+					&& !static_json::traits::is_string_v<T>
+					&& !static_json::traits::is_string_ref_v<T>
 					&& !static_json::traits::has_push_back<T>())
 				{
-					rapidjson_iarchive ja(value);
+					rapidjson_iarchive ja(value, mode_, resource_);
 					ja >> b;
 				}
 			}
@@ -145,16 +201,11 @@ namespace archive {
 			case rapidjson::kArrayType:
 			{
 				if constexpr (static_json::traits::has_push_back<T>() &&
-						!std::is_same_v<std::decay_t<T>, std::string> &&
+						!static_json::traits::is_string_v<T> &&
 						!std::is_same_v<std::decay_t<T>, std::wstring>)
 				{
-					for (auto& a : value.GetArray())
-					{
-						std::decay_t<typename T::value_type> tmp;
-						rapidjson_iarchive ja(a);
-						ja >> tmp;
-						b.push_back(tmp);
-					}
+					rapidjson_iarchive ja(value, mode_, resource_);
+					ja >> b;
 				}
 			}
 			break;
@@ -162,13 +213,13 @@ namespace archive {
 			case rapidjson::kTrueType:
 			case rapidjson::kNumberType:
 			{
-				rapidjson_iarchive ja(value);
+				rapidjson_iarchive ja(value, mode_, resource_);
 				ja >> b;
 			}
 			break;
 			case rapidjson::kStringType:
 			{
-				rapidjson_iarchive ja(value);
+				rapidjson_iarchive ja(value, mode_, resource_);
 				ja >> b;
 			}
 			break;
@@ -184,15 +235,41 @@ namespace archive {
 			static_json::serialize_adl(*this, v);
 		}
 
+		// 字段通常按serialize中声明的顺序出现, 因此先比较上一个命中成员的下一个,
+		// 不命中时才做一次FindMember, 按序出现时整个对象只需O(n)次比较.
+		const rapidjson::Value* find_member(char const* name)
+		{
+			if (!json_.IsObject())
+				return nullptr;
+
+			auto end = json_.MemberEnd();
+			auto length = static_cast<rapidjson::SizeType>(std::strlen(name));
+			if (next_ != end && next_->name.GetStringLength() == length &&
+				std::memcmp(next_->name.GetString(), name, length) == 0)
+				return &(next_++)->value;
+
+			auto it = json_.FindMember(rapidjson::StringRef(name, length));
+			if (it == end)
+				return nullptr;
+			next_ = it + 1;
+			return &it->value;
+		}
+
 		const rapidjson::Value& json_;
+		static_json::load_mode mode_;
+		std::pmr::memory_resource* resource_;
+		rapidjson::Value::ConstMemberIterator next_;
 	};
 
 	// 普通数据结构 到 rapidjson.
+	// 所有节点都从调用者提供的alloc中分配, 通常为rapidjson::Document的
+	// GetAllocator(), 不同线程使用各自的alloc即可并行序列化.
 	//
 	struct rapidjson_oarchive
 	{
-		rapidjson_oarchive(rapidjson::Value& json)
+		rapidjson_oarchive(rapidjson::Value& json, rapidjson::Value::AllocatorType& alloc)
 			: json_(json)
+			, alloc_(alloc)
 		{}
 
 		template <typename T>
@@ -225,38 +302,47 @@ namespace archive {
 				json_.SetFloat(value);
 			else if constexpr (std::is_same_v<std::decay_t<T>, double>)
 				json_.SetDouble(value);
-			else if constexpr (std::is_same_v<std::decay_t<T>, std::string>)
+			else if constexpr (static_json::traits::is_string_v<T>)
 				json_.SetString(value.c_str(), static_cast<rapidjson::SizeType>(value.size()));
+			else if constexpr (std::is_same_v<std::decay_t<T>, std::string_view>)
+				json_.SetString(value.data(), static_cast<rapidjson::SizeType>(value.size()));
+			else if constexpr (std::is_same_v<std::decay_t<T>, const char*>)
+			{
+				if (value)
+					json_.SetString(rapidjson::StringRef(value));
+				else
+					json_.SetNull();
+			}
 			else if constexpr (static_json::traits::is_mapping_v<T>)
 			{
 				rapidjson::Value temp;
 				json_.SetObject();
 				for (auto& v : value)
 				{
-					rapidjson_oarchive ja(temp);
+					rapidjson_oarchive ja(temp, alloc_);
 					ja << v.second;
-					json_.AddMember(rapidjson::StringRef(v.first.c_str()), temp, rapidjson_ugly_document_alloc());
+					json_.AddMember(rapidjson::StringRef(v.first.c_str()), temp, alloc_);
 				}
 			}
 			else if constexpr (static_json::traits::is_std_optional_v<std::decay_t<T>>)
 			{
 				if (value)
 				{
-					rapidjson_oarchive ja(json_);
+					rapidjson_oarchive ja(json_, alloc_);
 					ja << value.value();
 				}
 			}
 			else if constexpr (static_json::traits::has_push_back<std::decay_t<T>>() &&
-				!std::is_same_v<std::decay_t<T>, std::string> &&
+				!static_json::traits::is_string_v<T> &&
 				!std::is_same_v<std::decay_t<T>, std::wstring>)
 			{
 				json_.SetArray();
 				for (auto& n : value)
 				{
 					rapidjson::Value arr;
-					rapidjson_oarchive ja(arr);
+					rapidjson_oarchive ja(arr, alloc_);
 					ja << n;
-					json_.PushBack(arr, rapidjson_ugly_document_alloc());
+					json_.PushBack(arr, alloc_);
 				}
 			}
 			else
@@ -278,9 +364,10 @@ namespace archive {
 		{
 			rapidjson::Value temp;
 			if constexpr (std::is_arithmetic_v<std::decay_t<T>>
-				|| std::is_same_v<std::decay_t<T>, std::string>)
+				|| static_json::traits::is_string_v<T>
+				|| static_json::traits::is_string_ref_v<T>)
 			{
-				rapidjson_oarchive ja(temp);
+				rapidjson_oarchive ja(temp, alloc_);
 				ja << b;
 			}
 			else
@@ -291,16 +378,16 @@ namespace archive {
 					for (auto& n : b)
 					{
 						rapidjson::Value arr;
-						rapidjson_oarchive ja(arr);
+						rapidjson_oarchive ja(arr, alloc_);
 						ja << n;
-						temp.PushBack(arr, rapidjson_ugly_document_alloc());
+						temp.PushBack(arr, alloc_);
 					}
 				}
 				else if constexpr (static_json::traits::is_std_optional_v<T>)
 				{
 					if (b)
 					{
-						rapidjson_oarchive ja(temp);
+						rapidjson_oarchive ja(temp, alloc_);
 						ja << b.value();
 					}
 					else
@@ -314,19 +401,19 @@ namespace archive {
 					temp.SetObject();
 					for (auto& v : b)
 					{
-						rapidjson_oarchive ja(value);
+						rapidjson_oarchive ja(value, alloc_);
 						ja << v.second;
-						temp.AddMember(rapidjson::StringRef(v.first.c_str()), value, rapidjson_ugly_document_alloc());
+						temp.AddMember(rapidjson::StringRef(v.first.c_str()), value, alloc_);
 					}
 				}
 				else
 				{
-					rapidjson_oarchive ja(temp);
+					rapidjson_oarchive ja(temp, alloc_);
 					ja << b;
 				}
 			}
 
-			json_.AddMember(rapidjson::StringRef(name), temp, rapidjson_ugly_document_alloc());
+			json_.AddMember(rapidjson::StringRef(name), temp, alloc_);
 		}
 
 		template <typename T>
@@ -336,5 +423,920 @@ namespace archive {
 		}
 
 		rapidjson::Value& json_;
+		rapidjson::Value::AllocatorType& alloc_;
+	};
+
+	// 以std::string作为rapidjson的输出流, 直接追加到调用者提供的字符串.
+	//
+	struct string_output_stream
+	{
+		typedef char Ch;
+
+		explicit string_output_stream(std::string& str)
+			: str_(str)
+		{}
+
+		void Put(char c)
+		{
+			str_.push_back(c);
+		}
+
+		void Flush()
+		{}
+
+		std::string& str_;
+	};
+
+	namespace detail {
+
+		template <typename OutputStream>
+		inline void put_bytes(OutputStream& os, const char* str, std::size_t length)
+		{
+			rapidjson::PutReserve(os, length);
+			for (std::size_t i = 0; i < length; i++)
+				rapidjson::PutUnsafe(os, str[i]);
+		}
+
+		inline void put_bytes(rapidjson::StringBuffer& os, const char* str, std::size_t length)
+		{
+			std::memcpy(os.Push(length), str, length);
+		}
+
+		inline void put_bytes(string_output_stream& os, const char* str, std::size_t length)
+		{
+			os.str_.append(str, length);
+		}
+
+		// 写出带引号的json字符串, 转义由rapidjson::internal::WriteEscaped(运行时选择的SIMD实现)
+		// 整段完成. 按块转义到栈上的缓冲区再写出, 每个字符最多转义为6个字符.
+		template <typename OutputStream>
+		inline void put_escaped(OutputStream& os, const char* str, std::size_t length)
+		{
+			constexpr std::size_t chunk = 512;
+			char buffer[chunk * 6];
+
+			put_bytes(os, "\"", 1);
+			for (auto end = str + length; str != end;)
+			{
+				auto n = (std::min)(chunk, static_cast<std::size_t>(end - str));
+				auto out = rapidjson::internal::WriteEscaped(buffer, str, str + n);
+				put_bytes(os, buffer, out - buffer);
+				str += n;
+			}
+			put_bytes(os, "\"", 1);
+		}
+
+		inline void put_escaped(rapidjson::StringBuffer& os, const char* str, std::size_t length)
+		{
+			auto reserved = length * 6 + 2;
+			auto begin = os.Push(reserved);
+			auto out = begin;
+			*out++ = '"';
+			out = rapidjson::internal::WriteEscaped(out, str, str + length);
+			*out++ = '"';
+			os.Pop(reserved - (out - begin));
+		}
+
+		template <typename Writer, typename = void>
+		struct has_raw_key : std::false_type {};
+		template <typename Writer>
+		struct has_raw_key<Writer, std::void_t<decltype(std::declval<Writer&>().RawKey(
+			std::declval<const char*>(), std::declval<std::size_t>()))>>
+			: std::true_type {};
+	}
+
+	// 在rapidjson::Writer基础上增加RawKey, 用于整块写入nvp中编译期生成的带引号key,
+	// 省去每次对常量key的转义扫描. 冒号仍由Writer按状态写出. 字符串和key整段SIMD转义.
+	// double默认用Dragonbox输出可往返的最短十进制.
+	//
+	template <typename OutputStream,
+		unsigned writeFlags = rapidjson::kWriteDefaultFlags | rapidjson::kWriteShortestDoubleFlag>
+	class json_writer
+		: public rapidjson::Writer<OutputStream, rapidjson::UTF8<>,
+			rapidjson::UTF8<>, rapidjson::CrtAllocator, writeFlags>
+	{
+		using base_type = rapidjson::Writer<OutputStream, rapidjson::UTF8<>,
+			rapidjson::UTF8<>, rapidjson::CrtAllocator, writeFlags>;
+
+	public:
+		explicit json_writer(OutputStream& os)
+			: base_type(os)
+		{}
+
+		bool RawKey(const char* quoted, std::size_t length)
+		{
+			this->Prefix(rapidjson::kStringType);
+			detail::put_bytes(*this->os_, quoted, length);
+			return this->EndValue(true);
+		}
+
+		// 不校验编码时, 字符串整段用SIMD转义, 不再逐字符经过Writer::WriteString.
+		bool String(const char* str, rapidjson::SizeType length, bool copy = false)
+		{
+			if constexpr ((writeFlags & rapidjson::kWriteValidateEncodingFlag) != 0)
+			{
+				return base_type::String(str, length, copy);
+			}
+			else
+			{
+				this->Prefix(rapidjson::kStringType);
+				detail::put_escaped(*this->os_, str, length);
+				return this->EndValue(true);
+			}
+		}
+
+		bool String(const char* const& str)
+		{
+			return String(str, rapidjson::internal::StrLen(str));
+		}
+
+		bool String(const std::string& str)
+		{
+			return String(str.data(), static_cast<rapidjson::SizeType>(str.size()));
+		}
+
+		bool Key(const char* str, rapidjson::SizeType length, bool copy = false)
+		{
+			return String(str, length, copy);
+		}
+
+		bool Key(const char* const& str)
+		{
+			return String(str);
+		}
+
+		bool Key(const std::string& str)
+		{
+			return String(str);
+		}
+	};
+
+	// 普通数据结构 直接写入 rapidjson::Writer, 不构建DOM.
+	//
+	template <typename Writer>
+	struct rapidjson_writer_oarchive
+	{
+		rapidjson_writer_oarchive(Writer& writer)
+			: writer_(writer)
+		{}
+
+		template <typename T>
+		rapidjson_writer_oarchive& operator<<(static_json::nvp<T> const& wrap)
+		{
+			save(wrap.name(), wrap.value(), wrap.quoted_name(), wrap.quoted_name_length());
+			return *this;
+		}
+
+		template <typename T>
+		rapidjson_writer_oarchive& operator<<(T const& value)
+		{
+			return operator<<(const_cast<T&>(value));
+		}
+
+		template <typename T>
+		rapidjson_writer_oarchive& operator<<(T& value)
+		{
+			if constexpr (std::is_same_v<std::decay_t<T>, int>)
+				writer_.Int(value);
+			else if constexpr (std::is_same_v<std::decay_t<T>, unsigned int>)
+				writer_.Uint(value);
+			else if constexpr (std::is_same_v<std::decay_t<T>, int64_t>)
+				writer_.Int64(value);
+			else if constexpr (std::is_same_v<std::decay_t<T>, uint64_t>)
+				writer_.Uint64(value);
+			else if constexpr (std::is_same_v<std::decay_t<T>, bool>)
+				writer_.Bool(value);
+			else if constexpr (std::is_same_v<std::decay_t<T>, float>)
+				writer_.Double(static_cast<double>(value));
+			else if constexpr (std::is_same_v<std::decay_t<T>, double>)
+				writer_.Double(value);
+			else if constexpr (static_json::traits::is_string_v<T>)
+				writer_.String(value.c_str(), static_cast<rapidjson::SizeType>(value.size()));
+			else if constexpr (std::is_same_v<std::decay_t<T>, std::string_view>)
+				writer_.String(value.data(), static_cast<rapidjson::SizeType>(value.size()));
+			else if constexpr (std::is_same_v<std::decay_t<T>, const char*>)
+			{
+				if (value)
+					writer_.String(value);
+				else
+					writer_.Null();
+			}
+			else if constexpr (static_json::traits::is_mapping_v<T>)
+			{
+				writer_.StartObject();
+				for (auto& v : value)
+				{
+					writer_.Key(v.first.c_str(), static_cast<rapidjson::SizeType>(v.first.size()));
+					*this << v.second;
+				}
+				writer_.EndObject();
+			}
+			else if constexpr (static_json::traits::is_std_optional_v<std::decay_t<T>>)
+			{
+				if (value)
+					*this << value.value();
+				else
+					writer_.Null();
+			}
+			else if constexpr (static_json::traits::has_push_back<std::decay_t<T>>() &&
+				!static_json::traits::is_string_v<T> &&
+				!std::is_same_v<std::decay_t<T>, std::wstring>)
+			{
+				writer_.StartArray();
+				for (auto& n : value)
+					*this << n;
+				writer_.EndArray();
+			}
+			else
+			{
+				writer_.StartObject();
+				save(value);
+				writer_.EndObject();
+			}
+			return *this;
+		}
+
+		template <typename T>
+		rapidjson_writer_oarchive& operator&(T const& v)
+		{
+			return operator<<(v);
+		}
+
+		template <typename T>
+		void save(char const* name, T& b, char const* quoted = nullptr, std::size_t quoted_length = 0)
+		{
+			// 与rapidjson_oarchive一致, 空的optional字段不输出.
+			if constexpr (static_json::traits::is_std_optional_v<std::decay_t<T>>)
+			{
+				if (!b)
+					return;
+			}
+
+			if constexpr (detail::has_raw_key<Writer>::value)
+			{
+				if (quoted)
+					writer_.RawKey(quoted, quoted_length);
+				else
+					writer_.Key(name);
+			}
+			else
+			{
+				writer_.Key(name);
+			}
+			*this << b;
+		}
+
+		template <typename T>
+		void save(T& v)
+		{
+			static_json::serialize_adl(*this, v);
+		}
+
+		Writer& writer_;
 	};
+
+	struct rapidjson_sax_iarchive;
+
+	namespace detail {
+
+		// rapidjson_sax_iarchive 内部使用的SAX事件.
+		struct sax_event
+		{
+			enum kind_type
+			{
+				null_value,
+				bool_value,
+				int64_value,
+				uint64_value,
+				double_value,
+				string_value,
+				start_object,
+				start_array,
+			};
+
+			bool is_start() const
+			{
+				return kind == start_object || kind == start_array;
+			}
+
+			kind_type kind = null_value;
+			bool b = false;
+			int64_t i = 0;
+			uint64_t u = 0;
+			double d = 0;
+			const char* str = nullptr;
+			rapidjson::SizeType length = 0;
+			bool copy = false;
+		};
+
+		// 处理一个值的事件, 每个类型T由sax_value<T>::handle生成.
+		using sax_handler = bool (*)(rapidjson_sax_iarchive&, void*, const sax_event&);
+
+		// 取得数组中第index个元素或映射中key对应的值, 返回其地址.
+		using sax_creator = void* (*)(rapidjson_sax_iarchive&, void*, const char*, std::size_t);
+
+		// 数组或映射结束时调用, 删除本次没有解码到的旧元素.
+		using sax_finisher = void (*)(rapidjson_sax_iarchive&, void*, std::size_t);
+
+		// 由serialize收集到的一个字段.
+		struct sax_field
+		{
+			const char* name;
+			void* object;
+			sax_handler handler;
+		};
+
+		// 一个类型的字段名完美哈希表, 在该类型第一次解码时由serialize收集到的
+		// 字段名构建, 之后查找一个key只需一次哈希探测和一次memcmp.
+		class sax_key_table
+		{
+		public:
+			static constexpr std::size_t npos = ~std::size_t(0);
+
+			sax_key_table(const sax_field* fields, std::size_t size)
+			{
+				// 复制字段名, 表为静态对象, 而KEY_NVP的名字可能是临时字符串.
+				for (std::size_t i = 0; i < size; i++)
+				{
+					names_.emplace_back(fields[i].name);
+					addresses_.push_back(reinterpret_cast<std::uintptr_t>(fields[i].name));
+					hashes_.push_back(hash(names_[i].data(), names_[i].size()));
+				}
+
+				// 字段名重复(或64位哈希相同)时任何seed都无法消除冲突, 直接交由调用者线性查找.
+				auto sorted = hashes_;
+				std::sort(sorted.begin(), sorted.end());
+				if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
+					return;
+
+				// 表大小至少为字段数的2倍, 找不到无冲突的seed时加倍重试, 最多64K个槽.
+				for (shift_ = 61; shift_ >= 48; shift_--)
+				{
+					if ((std::size_t(1) << (64 - shift_)) < size * 2)
+						continue;
+					for (seed_ = 0; seed_ < 64; seed_++)
+						if (build())
+							return;
+				}
+
+				// 字段过多, 交由调用者线性查找.
+				slots_.clear();
+			}
+
+			bool usable() const
+			{
+				return !slots_.empty();
+			}
+
+			// 同一类型的serialize可能因条件分支而收集到不同的字段.
+			// 字段名通常是字符串字面量, 地址相同时不再比较内容; 只比较地址的值, 不访问旧指针.
+			bool same_fields(const sax_field* fields, std::size_t size) const
+			{
+				if (size != names_.size())
+					return false;
+				for (std::size_t i = 0; i < size; i++)
+				{
+					if (reinterpret_cast<std::uintptr_t>(fields[i].name) != addresses_[i] &&
+						names_[i] != fields[i].name)
+						return false;
+				}
+				return true;
+			}
+
+			std::size_t find(const char* key, std::size_t length) const
+			{
+				auto index = slots_[slot(hash(key, length))];
+				if (index == 0)
+					return npos;
+				index--;
+				if (names_[index] != std::string_view(key, length))
+					return npos;
+				return index;
+			}
+
+		private:
+			static uint64_t hash(const char* key, std::size_t length)
+			{
+				uint64_t h = 0xcbf29ce484222325ull;
+				for (std::size_t i = 0; i < length; i++)
+					h = (h ^ static_cast<unsigned char>(key[i])) * 0x100000001b3ull;
+				return h;
+			}
+
+			std::size_t slot(uint64_t h) const
+			{
+				return static_cast<std::size_t>(((h ^ seed_) * 0x9e3779b97f4a7c15ull) >> shift_);
+			}
+
+			bool build()
+			{
+				slots_.assign(std::size_t(1) << (64 - shift_), 0);
+				for (std::size_t i = 0; i < hashes_.size(); i++)
+				{
+					auto& s = slots_[slot(hashes_[i])];
+					if (s != 0)
+						return false;
+					s = static_cast<uint32_t>(i + 1);
+				}
+				return true;
+			}
+
+			uint64_t seed_ = 0;
+			unsigned shift_ = 0;
+			std::vector<uint32_t> slots_;
+			std::vector<std::string> names_;
+			std::vector<std::uintptr_t> addresses_;
+			std::vector<uint64_t> hashes_;
+		};
+
+		struct sax_frame
+		{
+			enum kind_type
+			{
+				object_frame,
+				array_frame,
+				mapping_frame,
+				skip_frame,
+			};
+
+			kind_type kind;
+			void* object;
+			sax_handler element;
+			sax_creator create;
+			sax_finisher finish;
+			const sax_key_table* keys;	// object_frame: 为空时线性查找字段.
+			std::size_t fields;	// object_frame: 字段在fields_中的起始位置.
+			std::size_t count;	// array_frame: 已解码的元素数, mapping_frame: 在seen_中的起始位置,
+								// skip_frame: 被跳过的嵌套深度.
+		};
+
+		template <typename T>
+		struct sax_value
+		{
+			static bool handle(rapidjson_sax_iarchive& ar, void* object, const sax_event& e);
+
+			static void* create_element(rapidjson_sax_iarchive&, void* object, const char*, std::size_t)
+			{
+				auto& container = *static_cast<T*>(object);
+				container.emplace_back();
+				return std::addressof(container.back());
+			}
+
+			// load_mode::update, 复用已有的元素.
+			static void* update_element(rapidjson_sax_iarchive&, void* object, const char*, std::size_t index)
+			{
+				auto& container = *static_cast<T*>(object);
+				if (index < container.size())
+					return std::addressof(container[index]);
+				container.emplace_back();
+				return std::addressof(container.back());
+			}
+
+			static void truncate(rapidjson_sax_iarchive&, void* object, std::size_t size)
+			{
+				auto& container = *static_cast<T*>(object);
+				if (size < container.size())
+					container.erase(container.begin() + size, container.end());
+			}
+
+			static void* create_mapped(rapidjson_sax_iarchive& ar, void* object, const char* key, std::size_t length);
+
+			// load_mode::update, 删除json中没有出现的key.
+			static void erase_mapped(rapidjson_sax_iarchive& ar, void* object, std::size_t first);
+		};
+	}
+
+	// rapidjson SAX事件 直接到 普通数据结构, 不构建DOM.
+	// 由rapidjson::GenericReader驱动, 每遇到一个对象/数组便压入一个由
+	// serialize生成的处理帧, 解析只需一遍, 也不分配任何GenericValue.
+	//
+	struct rapidjson_sax_iarchive
+	{
+		explicit rapidjson_sax_iarchive(
+			static_json::load_mode mode = static_json::load_mode::append,
+			std::pmr::memory_resource* resource = nullptr)
+			: root_(nullptr)
+			, root_handler_(nullptr)
+			, mode_(mode)
+			, resource_(resource)
+		{}
+
+		template <typename T>
+		explicit rapidjson_sax_iarchive(T& value,
+			static_json::load_mode mode = static_json::load_mode::append,
+			std::pmr::memory_resource* resource = nullptr)
+			: rapidjson_sax_iarchive(mode, resource)
+		{
+			reset(value);
+		}
+
+		// 重新指定解码目标, 保留内部缓冲区的容量, 用于连续解码多个json.
+		template <typename T>
+		void reset(T& value)
+		{
+			root_ = std::addressof(value);
+			root_handler_ = &detail::sax_value<T>::handle;
+			target_ = nullptr;
+			target_handler_ = nullptr;
+			frames_.clear();
+			fields_.clear();
+			seen_.clear();
+		}
+
+		// 同时更换解码模式和resource.
+		template <typename T>
+		void reset(T& value, static_json::load_mode mode, std::pmr::memory_resource* resource)
+		{
+			mode_ = mode;
+			resource_ = resource;
+			reset(value);
+		}
+
+		// serialize 中声明的字段, 收集到当前对象帧.
+		template <typename T>
+		rapidjson_sax_iarchive& operator>>(static_json::nvp<T> const& wrap)
+		{
+			fields_.push_back({ wrap.name(), std::addressof(wrap.value()),
+				&detail::sax_value<std::decay_t<T>>::handle });
+			return *this;
+		}
+
+		template <typename T>
+		rapidjson_sax_iarchive& operator&(static_json::nvp<T> const& wrap)
+		{
+			return operator>>(wrap);
+		}
+
+		// 以下为rapidjson Handler接口.
+		bool Null()
+		{
+			detail::sax_event e;
+			e.kind = detail::sax_event::null_value;
+			return value(e);
+		}
+
+		bool Bool(bool b)
+		{
+			detail::sax_event e;
+			e.kind = detail::sax_event::bool_value;
+			e.b = b;
+			return value(e);
+		}
+
+		bool Int(int i)
+		{
+			return Int64(i);
+		}
+
+		bool Uint(unsigned u)
+		{
+			return Uint64(u);
+		}
+
+		bool Int64(int64_t i)
+		{
+			detail::sax_event e;
+			e.kind = detail::sax_event::int64_value;
+			e.i = i;
+			return value(e);
+		}
+
+		bool Uint64(uint64_t u)
+		{
+			detail::sax_event e;
+			e.kind = detail::sax_event::uint64_value;
+			e.u = u;
+			return value(e);
+		}
+
+		bool Double(double d)
+		{
+			detail::sax_event e;
+			e.kind = detail::sax_event::double_value;
+			e.d = d;
+			return value(e);
+		}
+
+		bool RawNumber(const char* str, rapidjson::SizeType length, bool copy)
+		{
+			return String(str, length, copy);
+		}
+
+		bool String(const char* str, rapidjson::SizeType length, bool copy)
+		{
+			detail::sax_event e;
+			e.kind = detail::sax_event::string_value;
+			e.str = str;
+			e.length = length;
+			e.copy = copy;
+			return value(e);
+		}
+
+		bool StartObject()
+		{
+			detail::sax_event e;
+			e.kind = detail::sax_event::start_object;
+			return value(e);
+		}
+
+		bool Key(const char* str, rapidjson::SizeType length, bool)
+		{
+			auto& f = frames_.back();
+			switch (f.kind)
+			{
+			case detail::sax_frame::object_frame:
+			{
+				target_handler_ = nullptr;
+				if (f.keys)
+				{
+					auto i = f.keys->find(str, length);
+					if (i != detail::sax_key_table::npos)
+					{
+						target_ = fields_[f.fields + i].object;
+						target_handler_ = fields_[f.fields + i].handler;
+					}
+					break;
+				}
+				for (auto i = f.fields; i < fields_.size(); i++)
+				{
+					auto& field = fields_[i];
+					if (std::strncmp(field.name, str, length) == 0 && field.name[length] == '\0')
+					{
+						target_ = field.object;
+						target_handler_ = field.handler;
+						break;
+					}
+				}
+			}
+			break;
+			case detail::sax_frame::mapping_frame:
+				target_ = f.create(*this, f.object, str, length);
+				target_handler_ = f.element;
+				break;
+			default:
+				break;
+			}
+			return true;
+		}
+
+		bool EndObject(rapidjson::SizeType)
+		{
+			return end();
+		}
+
+		bool StartArray()
+		{
+			detail::sax_event e;
+			e.kind = detail::sax_event::start_array;
+			return value(e);
+		}
+
+		bool EndArray(rapidjson::SizeType)
+		{
+			return end();
+		}
+
+		// 以下由 sax_value<T>::handle 调用.
+		template <typename T>
+		void push_object(T& v)
+		{
+			auto begin = fields_.size();
+			frames_.push_back({ detail::sax_frame::object_frame, std::addressof(v),
+				nullptr, nullptr, nullptr, nullptr, begin, 0 });
+			static_json::serialize_adl(*this, v);
+
+			static const detail::sax_key_table keys(fields_.data() + begin, fields_.size() - begin);
+			if (keys.usable() && keys.same_fields(fields_.data() + begin, fields_.size() - begin))
+				frames_.back().keys = &keys;
+		}
+
+		void push_container(detail::sax_frame::kind_type kind, void* object,
+			detail::sax_handler element, detail::sax_creator create,
+			detail::sax_finisher finish = nullptr)
+		{
+			auto count = kind == detail::sax_frame::mapping_frame ? seen_.size() : 0;
+			frames_.push_back({ kind, object, element, create, finish, nullptr, 0, count });
+		}
+
+		void skip()
+		{
+			frames_.push_back({ detail::sax_frame::skip_frame,
+				nullptr, nullptr, nullptr, nullptr, nullptr, 0, 1 });
+		}
+
+		bool update() const
+		{
+			return mode_ == static_json::load_mode::update;
+		}
+
+		// 新建optional值和映射key时使用, 为空时使用默认分配器.
+		std::pmr::memory_resource* resource() const
+		{
+			return resource_;
+		}
+
+		// 映射查找key时复用的缓冲区.
+		std::string& key_buffer()
+		{
+			return key_buffer_;
+		}
+
+		// load_mode::update 时记录映射中本次解码过的值.
+		std::vector<const void*>& seen()
+		{
+			return seen_;
+		}
+
+	private:
+		bool value(const detail::sax_event& e)
+		{
+			void* object = nullptr;
+			detail::sax_handler handler = nullptr;
+
+			if (frames_.empty())
+			{
+				object = root_;
+				handler = root_handler_;
+			}
+			else
+			{
+				auto& f = frames_.back();
+				switch (f.kind)
+				{
+				case detail::sax_frame::skip_frame:
+					if (e.is_start())
+						f.count++;
+					return true;
+				case detail::sax_frame::array_frame:
+					object = f.create(*this, f.object, nullptr, f.count++);
+					handler = f.element;
+					break;
+				default:
+					object = target_;
+					handler = target_handler_;
+					break;
+				}
+			}
+
+			// 不在serialize中的字段, 整个跳过.
+			if (!handler)
+			{
+				if (e.is_start())
+					skip();
+				return true;
+			}
+
+			return handler(*this, object, e);
+		}
+
+		bool end()
+		{
+			auto& f = frames_.back();
+			if (f.kind == detail::sax_frame::skip_frame && --f.count > 0)
+				return true;
+			if (f.kind == detail::sax_frame::object_frame)
+				fields_.resize(f.fields);
+			if (f.finish)
+				f.finish(*this, f.object, f.count);
+			frames_.pop_back();
+			return true;
+		}
+
+		void* root_;
+		detail::sax_handler root_handler_;
+		static_json::load_mode mode_;
+		std::pmr::memory_resource* resource_;
+		void* target_ = nullptr;
+		detail::sax_handler target_handler_ = nullptr;
+		std::string key_buffer_;
+		std::vector<detail::sax_frame> frames_;
+		std::vector<detail::sax_field> fields_;
+		std::vector<const void*> seen_;
+	};
+
+	namespace detail {
+
+		template <typename T>
+		bool sax_value<T>::handle(rapidjson_sax_iarchive& ar, void* object, const sax_event& e)
+		{
+			T& value = *static_cast<T*>(object);
+
+			if constexpr (std::is_same_v<T, bool>)
+			{
+				if (e.kind == sax_event::bool_value)
+					value = e.b;
+			}
+			else if constexpr (std::is_arithmetic_v<T>)
+			{
+				if (e.kind == sax_event::int64_value)
+					value = static_cast<T>(e.i);
+				else if (e.kind == sax_event::uint64_value)
+					value = static_cast<T>(e.u);
+				else if (e.kind == sax_event::double_value)
+					value = static_cast<T>(e.d);
+			}
+			else if constexpr (static_json::traits::is_string_v<T>)
+			{
+				if (e.kind == sax_event::string_value)
+					value.assign(e.str, e.length);
+			}
+			else if constexpr (static_json::traits::is_string_ref_v<T>)
+			{
+				if (e.kind == sax_event::string_value)
+				{
+					// 非in-situ解析时字符串在回调后即失效, 无法引用.
+					if (e.copy)
+						return false;
+					if constexpr (std::is_same_v<T, std::string_view>)
+						value = std::string_view(e.str, e.length);
+					else
+						value = e.str;
+				}
+			}
+			else if constexpr (static_json::traits::is_mapping_v<T>)
+			{
+				if (e.kind == sax_event::start_object)
+				{
+					ar.push_container(sax_frame::mapping_frame, object,
+						&sax_value<typename T::mapped_type>::handle, &create_mapped,
+						ar.update() ? &erase_mapped : nullptr);
+					return true;
+				}
+			}
+			else if constexpr (static_json::traits::is_std_optional_v<T>)
+			{
+				if (e.kind == sax_event::null_value)
+				{
+					value.reset();
+					return true;
+				}
+				if (!ar.update() || !value)
+					value = static_json::traits::make_with_resource<typename T::value_type>(ar.resource());
+				return sax_value<typename T::value_type>::handle(ar, std::addressof(*value), e);
+			}
+			else if constexpr (static_json::traits::has_push_back<T>())
+			{
+				if (e.kind == sax_event::start_array)
+				{
+					auto element = &sax_value<std::decay_t<typename T::value_type>>::handle;
+					if (ar.update())
+					{
+						if constexpr (static_json::traits::is_resizable_random_access_v<T>)
+						{
+							ar.push_container(sax_frame::array_frame, object, element, &update_element, &truncate);
+							return true;
+						}
+						value.clear();
+					}
+					ar.push_container(sax_frame::array_frame, object, element, &create_element);
+					return true;
+				}
+			}
+			else
+			{
+				if (e.kind == sax_event::start_object)
+				{
+					ar.push_object(value);
+					return true;
+				}
+			}
+
+			if (e.is_start())
+				ar.skip();
+			return true;
+		}
+
+		template <typename T>
+		void* sax_value<T>::create_mapped(rapidjson_sax_iarchive& ar, void* object, const char* key, std::size_t length)
+		{
+			auto& container = *static_cast<T*>(object);
+			auto result = [&]()
+			{
+				if constexpr (std::is_same_v<typename T::key_type, std::string>)
+				{
+					auto& name = ar.key_buffer();
+					name.assign(key, length);
+					return container.try_emplace(name);
+				}
+				else
+				{
+					return container.try_emplace(static_json::traits::make_with_resource<
+						typename T::key_type>(ar.resource(), key, length));
+				}
+			}();
+			if (ar.update())
+				ar.seen().push_back(std::addressof(result.first->second));
+			else if (!result.second)
+				result.first->second = typename T::mapped_type{};
+			return std::addressof(result.first->second);
+		}
+
+		template <typename T>
+		void sax_value<T>::erase_mapped(rapidjson_sax_iarchive& ar, void* object, std::size_t first)
+		{
+			auto& seen = ar.seen();
+			erase_unseen(*static_cast<T*>(object), seen.data() + first, seen.data() + seen.size());
+			seen.resize(first);
+		}
+	}
 }
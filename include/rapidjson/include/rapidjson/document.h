@@ -47,6 +47,22 @@ RAPIDJSON_DIAG_OFF(effc++)
 #include <utility> // std::move
 #endif
 
+/*! \def RAPIDJSON_MEMBER_INDEX_THRESHOLD
+    \ingroup RAPIDJSON_CONFIG
+    \brief Objects with at least this member capacity keep a hash index of member names.
+
+    FindMember(), and with it HasMember(), operator[] and RemoveMember(), then take constant
+    time on average instead of linear time on such objects. The index is built when the
+    capacity first reaches the threshold, and is stored after the members in the same block,
+    so it comes from the object's allocator. The default 0 disables it.
+
+    \note Define it to the same value in every translation unit. When it is enabled, do not
+        change member names through a MemberIterator, the index would not see the change.
+*/
+#ifndef RAPIDJSON_MEMBER_INDEX_THRESHOLD
+#define RAPIDJSON_MEMBER_INDEX_THRESHOLD 0
+#endif
+
 RAPIDJSON_NAMESPACE_BEGIN
 
 // Forward declaration.
@@ -653,7 +669,7 @@ public:
         switch (rhs.GetType()) {
         case kObjectType: {
                 SizeType count = rhs.data_.o.size;
-                Member* lm = reinterpret_cast<Member*>(allocator.Malloc(count * sizeof(Member)));
+                Member* lm = reinterpret_cast<Member*>(allocator.Malloc(MembersSize(count)));
                 const typename GenericValue<Encoding,SourceAllocator>::Member* rm = rhs.GetMembersPointer();
                 for (SizeType i = 0; i < count; i++) {
                     new (&lm[i].name) GenericValue(rm[i].name, allocator, copyConstStrings);
@@ -662,6 +678,7 @@ public:
                 data_.f.flags = kObjectFlag;
                 data_.o.size = data_.o.capacity = count;
                 SetMembersPointer(lm);
+                BuildMemberIndex();
             }
             break;
         case kArrayType: {
@@ -1178,8 +1195,9 @@ public:
     GenericValue& MemberReserve(SizeType newCapacity, Allocator &allocator) {
         RAPIDJSON_ASSERT(IsObject());
         if (newCapacity > data_.o.capacity) {
-            SetMembersPointer(reinterpret_cast<Member*>(allocator.Realloc(GetMembersPointer(), data_.o.capacity * sizeof(Member), newCapacity * sizeof(Member))));
+            SetMembersPointer(reinterpret_cast<Member*>(allocator.Realloc(GetMembersPointer(), MembersSize(data_.o.capacity), MembersSize(newCapacity))));
             data_.o.capacity = newCapacity;
+            BuildMemberIndex();
         }
         return *this;
     }
@@ -1228,7 +1246,7 @@ public:
         \note Earlier versions of Rapidjson returned a \c NULL pointer, in case
             the requested member doesn't exist. For consistency with e.g.
             \c std::map, this has been changed to MemberEnd() now.
-        \note Linear time complexity.
+        \note Linear time complexity, constant on average with \ref RAPIDJSON_MEMBER_INDEX_THRESHOLD.
     */
     MemberIterator FindMember(const Ch* name) {
         GenericValue n(StringRef(name));
@@ -1248,12 +1266,22 @@ public:
         \note Earlier versions of Rapidjson returned a \c NULL pointer, in case
             the requested member doesn't exist. For consistency with e.g.
             \c std::map, this has been changed to MemberEnd() now.
-        \note Linear time complexity.
+        \note Linear time complexity, constant on average with \ref RAPIDJSON_MEMBER_INDEX_THRESHOLD.
     */
     template <typename SourceAllocator>
     MemberIterator FindMember(const GenericValue<Encoding, SourceAllocator>& name) {
         RAPIDJSON_ASSERT(IsObject());
         RAPIDJSON_ASSERT(name.IsString());
+        if (const size_t indexSize = MemberIndexSize(data_.o.capacity)) {
+            // Like the linear scan, the first of duplicate names wins
+            const SizeType* index = GetMemberIndex();
+            Member* members = GetMembersPointer();
+            SizeType found = data_.o.size;
+            for (size_t i = MemberHash(name.GetString(), name.GetStringLength()) & (indexSize - 1); index[i] != 0; i = (i + 1) & (indexSize - 1))
+                if (index[i] - 1 < found && name.StringEqual(members[index[i] - 1].name))
+                    found = index[i] - 1;
+            return MemberIterator(members + found);
+        }
         MemberIterator member = MemberBegin();
         for ( ; member != MemberEnd(); ++member)
             if (name.StringEqual(member->name))
@@ -1295,6 +1323,8 @@ public:
         members[o.size].name.RawAssign(name);
         members[o.size].value.RawAssign(value);
         o.size++;
+        if (MemberIndexSize(o.capacity))
+            MemberIndexInsert(o.size - 1);
         return *this;
     }
 
@@ -1431,6 +1461,7 @@ public:
         for (MemberIterator m = MemberBegin(); m != MemberEnd(); ++m)
             m->~Member();
         data_.o.size = 0;
+        BuildMemberIndex();
     }
 
     //! Remove a member in object by its name.
@@ -1476,6 +1507,12 @@ public:
         RAPIDJSON_ASSERT(m >= MemberBegin() && m < MemberEnd());
 
         MemberIterator last(GetMembersPointer() + (data_.o.size - 1));
+        if (MemberIndexSize(data_.o.capacity)) {
+            const SizeType pos = static_cast<SizeType>(m - MemberBegin());
+            MemberIndexErase(MemberIndexFind(pos));
+            if (m != last)
+                GetMemberIndex()[MemberIndexFind(data_.o.size - 1)] = pos + 1;
+        }
         if (data_.o.size > 1 && m != last)
             *m = *last; // Move the last one to this place
         else
@@ -1519,6 +1556,7 @@ public:
             itr->~Member();
         std::memmove(static_cast<void*>(&*pos), &*last, static_cast<size_t>(MemberEnd() - last) * sizeof(Member));
         data_.o.size -= static_cast<SizeType>(last - first);
+        BuildMemberIndex();
         return pos;
     }
 
@@ -2047,13 +2085,106 @@ private:
     void SetObjectRaw(Member* members, SizeType count, Allocator& allocator) {
         data_.f.flags = kObjectFlag;
         if (count) {
-            Member* m = static_cast<Member*>(allocator.Malloc(count * sizeof(Member)));
+            Member* m = static_cast<Member*>(allocator.Malloc(MembersSize(count)));
             SetMembersPointer(m);
             std::memcpy(static_cast<void*>(m), members, count * sizeof(Member));
         }
         else
             SetMembersPointer(0);
         data_.o.size = data_.o.capacity = count;
+        BuildMemberIndex();
+    }
+
+    // Member name index, see RAPIDJSON_MEMBER_INDEX_THRESHOLD. It is a power-of-two table with
+    // linear probing right after the capacity members, each slot holds a member position + 1 or 0 if empty.
+    static size_t MemberIndexSize(SizeType capacity) {
+#if RAPIDJSON_MEMBER_INDEX_THRESHOLD > 0
+        if (capacity < RAPIDJSON_MEMBER_INDEX_THRESHOLD)
+            return 0;
+        size_t size = 1;
+        while (size < static_cast<size_t>(capacity) * 2)
+            size <<= 1;
+        return size;
+#else
+        (void)capacity;
+        return 0;
+#endif
+    }
+
+    static size_t MembersSize(SizeType capacity) {
+        return capacity * sizeof(Member) + MemberIndexSize(capacity) * sizeof(SizeType);
+    }
+
+    SizeType* GetMemberIndex() const { return reinterpret_cast<SizeType*>(GetMembersPointer() + data_.o.capacity); }
+
+    static size_t MemberHash(const Ch* str, SizeType length) {
+        const char* p = reinterpret_cast<const char*>(str);
+        size_t n = length * sizeof(Ch);
+        const uint64_t kMul = RAPIDJSON_UINT64_C2(0xFF51AFD7, 0xED558CCD);
+        uint64_t h = RAPIDJSON_UINT64_C2(0x9E3779B9, 0x7F4A7C15) ^ n;
+        uint64_t w;
+        for (; n >= sizeof(w); n -= sizeof(w), p += sizeof(w)) {
+            std::memcpy(&w, p, sizeof(w));
+            h = (h ^ w) * kMul;
+            h ^= h >> 32;
+        }
+        if (n > 0) {
+            w = 0;
+            std::memcpy(&w, p, n);
+            h = (h ^ w) * kMul;
+        }
+        h ^= h >> 33;
+        h *= RAPIDJSON_UINT64_C2(0xC4CEB9FE, 0x1A85EC53);
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
+    }
+
+    size_t MemberIndexHome(SizeType pos) const {
+        const GenericValue& name = GetMembersPointer()[pos].name;
+        return MemberHash(name.GetString(), name.GetStringLength()) & (MemberIndexSize(data_.o.capacity) - 1);
+    }
+
+    void MemberIndexInsert(SizeType pos) {
+        SizeType* index = GetMemberIndex();
+        const size_t mask = MemberIndexSize(data_.o.capacity) - 1;
+        size_t i = MemberIndexHome(pos);
+        while (index[i] != 0)
+            i = (i + 1) & mask;
+        index[i] = pos + 1;
+    }
+
+    // Slot of the member at pos
+    size_t MemberIndexFind(SizeType pos) const {
+        const SizeType* index = GetMemberIndex();
+        const size_t mask = MemberIndexSize(data_.o.capacity) - 1;
+        size_t i = MemberIndexHome(pos);
+        while (index[i] != pos + 1) {
+            RAPIDJSON_ASSERT(index[i] != 0);
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+
+    // Empty slot i, and move back the following entries that could not be placed at their home slot.
+    void MemberIndexErase(size_t i) {
+        SizeType* index = GetMemberIndex();
+        const size_t mask = MemberIndexSize(data_.o.capacity) - 1;
+        for (size_t j = (i + 1) & mask; index[j] != 0; j = (j + 1) & mask) {
+            const size_t home = MemberIndexHome(index[j] - 1);
+            if (j > i ? (home <= i || home > j) : (home <= i && home > j)) {
+                index[i] = index[j];
+                i = j;
+            }
+        }
+        index[i] = 0;
+    }
+
+    void BuildMemberIndex() {
+        if (const size_t indexSize = MemberIndexSize(data_.o.capacity)) {
+            std::memset(GetMemberIndex(), 0, indexSize * sizeof(SizeType));
+            for (SizeType pos = 0; pos < data_.o.size; pos++)
+                MemberIndexInsert(pos);
+        }
     }
 
     //! Initialize this value as constant string, without calling destructor.
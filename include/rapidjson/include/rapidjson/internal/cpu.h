@@ -0,0 +1,78 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef RAPIDJSON_INTERNAL_CPU_H_
+#define RAPIDJSON_INTERNAL_CPU_H_
+
+#include "../rapidjson.h"
+
+#ifdef RAPIDJSON_DISPATCH
+#include <immintrin.h>
+
+//! Compile one function for an instruction set that the rest of the build does not assume.
+#define RAPIDJSON_TARGET(isa) __attribute__((target(isa)))
+
+//! Aligned loads past the end of a null-terminated string stay within its page, but AddressSanitizer would report them.
+#define RAPIDJSON_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+
+RAPIDJSON_NAMESPACE_BEGIN
+namespace internal {
+
+//! Instruction set levels of the kernels selected at run time, in increasing order.
+enum CpuLevel {
+    kCpuScalar,
+    kCpuSSE2,
+    kCpuSSE42,
+    kCpuAVX2,
+    kCpuAVX512  //!< AVX-512F and AVX-512BW
+};
+
+//! Detect the best level supported by both the CPU and the operating system.
+inline CpuLevel DetectCpuLevel() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+        return kCpuAVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return kCpuAVX2;
+    if (__builtin_cpu_supports("sse4.2"))
+        return kCpuSSE42;
+    if (__builtin_cpu_supports("sse2"))
+        return kCpuSSE2;
+    return kCpuScalar;
+}
+
+inline CpuLevel& CpuLevelStorage() {
+    static CpuLevel level = DetectCpuLevel();
+    return level;
+}
+
+//! Level used by the dispatched kernels, detected on first use.
+inline CpuLevel GetCpuLevel() {
+    return CpuLevelStorage();
+}
+
+//! Lower the level, e.g. to compare kernels. It never rises above the detected level.
+/*! \note Not thread-safe, call it before parsing or writing starts.
+*/
+inline void SetCpuLevel(CpuLevel level) {
+    CpuLevel detected = DetectCpuLevel();
+    CpuLevelStorage() = level < detected ? level : detected;
+}
+
+} // namespace internal
+RAPIDJSON_NAMESPACE_END
+
+#endif // RAPIDJSON_DISPATCH
+
+#endif // RAPIDJSON_INTERNAL_CPU_H_
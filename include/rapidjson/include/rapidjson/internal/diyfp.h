@@ -172,6 +172,45 @@ struct DiyFp {
     int e;
 };
 
+// Full 64x64 -> 128 bit product
+inline uint64_t Multiply128(uint64_t a, uint64_t b, uint64_t* outHigh) {
+#if defined(_MSC_VER) && defined(_M_AMD64)
+    return _umul128(a, b, outHigh);
+#elif (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 6)) && defined(__x86_64__)
+    __extension__ typedef unsigned __int128 uint128;
+    uint128 p = static_cast<uint128>(a) * static_cast<uint128>(b);
+    *outHigh = static_cast<uint64_t>(p >> 64);
+    return static_cast<uint64_t>(p);
+#else
+    const uint64_t a0 = a & 0xFFFFFFFF, a1 = a >> 32, b0 = b & 0xFFFFFFFF, b1 = b >> 32;
+    uint64_t x0 = a0 * b0, x1 = a0 * b1, x2 = a1 * b0, x3 = a1 * b1;
+    x1 += (x0 >> 32); // can't give carry
+    x1 += x2;
+    if (x1 < x2)
+        x3 += (static_cast<uint64_t>(1) << 32);
+    *outHigh = x3 + (x1 >> 32);
+    return (x1 << 32) + (x0 & 0xFFFFFFFF);
+#endif
+}
+
+inline int CountLeadingZero64(uint64_t x) {
+    RAPIDJSON_ASSERT(x != 0);
+#if defined(_MSC_VER) && defined(_M_AMD64)
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return 63 - static_cast<int>(index);
+#elif defined(__GNUC__) && __GNUC__ >= 4
+    return __builtin_clzll(x);
+#else
+    int n = 0;
+    while (!(x & (static_cast<uint64_t>(1) << 63))) {
+        x <<= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
 inline DiyFp GetCachedPowerByIndex(size_t index) {
     // 10^-348, 10^-340, ..., 10^340
     static const uint64_t kCachedPowers_F[] = {
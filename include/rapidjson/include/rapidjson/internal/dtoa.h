@@ -22,6 +22,7 @@
 #include "itoa.h" // GetDigitsLut()
 #include "diyfp.h"
 #include "ieee754.h"
+#include "dragonbox.h"
 
 RAPIDJSON_NAMESPACE_BEGIN
 namespace internal {
@@ -213,7 +214,8 @@ inline char* Prettify(char* buffer, int length, int k, int maxDecimalPlaces) {
     }
 }
 
-inline char* dtoa(double value, char* buffer, int maxDecimalPlaces = 324) {
+//! \param shortest use Dragonbox, whose output is always the shortest that round-trips, instead of Grisu2.
+inline char* dtoa(double value, char* buffer, int maxDecimalPlaces = 324, bool shortest = false) {
     RAPIDJSON_ASSERT(maxDecimalPlaces >= 1);
     Double d(value);
     if (d.IsZero()) {
@@ -230,7 +232,10 @@ inline char* dtoa(double value, char* buffer, int maxDecimalPlaces = 324) {
             value = -value;
         }
         int length, K;
-        Grisu2(value, buffer, &length, &K);
+        if (shortest)
+            Dragonbox(value, buffer, &length, &K);
+        else
+            Grisu2(value, buffer, &length, &K);
         return Prettify(buffer, length, K, maxDecimalPlaces);
     }
 }
@@ -19,7 +19,9 @@
 #include "biginteger.h"
 #include "diyfp.h"
 #include "pow10.h"
+#include "pow5.h"
 #include <climits>
+#include <cstring>
 #include <limits>
 
 RAPIDJSON_NAMESPACE_BEGIN
@@ -127,6 +129,90 @@ inline bool StrtodFast(double d, int p, double* result) {
         return false;
 }
 
+#if RAPIDJSON_ENDIAN == RAPIDJSON_LITTLEENDIAN
+// Converts 8 ASCII digits at once (SWAR)
+inline uint32_t ParseEightDigits(const char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    v -= RAPIDJSON_UINT64_C2(0x30303030, 0x30303030);
+    v = (v * 10) + (v >> 8); // pairs of digits in every other byte
+    const uint64_t kMask = RAPIDJSON_UINT64_C2(0x000000FF, 0x000000FF);
+    const uint64_t kMul1 = RAPIDJSON_UINT64_C2(0x000F4240, 0x00000064); // 100 + (1000000 << 32)
+    const uint64_t kMul2 = RAPIDJSON_UINT64_C2(0x00002710, 0x00000001); // 1 + (10000 << 32)
+    return static_cast<uint32_t>((((v & kMask) * kMul1) + (((v >> 16) & kMask) * kMul2)) >> 32);
+}
+#endif
+
+// Eisel-Lemire: w * 10^q correctly rounded, from one or two 64x128 bit products.
+// see Lemire, "Number Parsing at a Gigabyte per Second" and https://github.com/fastfloat/fast_float
+// Returns false in the rare cases the truncated products cannot decide the rounding.
+inline bool StrtodEiselLemire(uint64_t w, int q, double* result) {
+    const int kSignificandSize = 52;
+    const int kInfinitePower = 0x7FF;
+    if (w == 0 || q < kPow5MinExponent) {
+        *result = 0.0;
+        return true;
+    }
+    if (q > kPow5MaxExponent) {
+        *result = std::numeric_limits<double>::infinity();
+        return true;
+    }
+
+    const int lz = CountLeadingZero64(w);
+    w <<= lz;
+
+    // Only the upper 64 + kSignificandSize + 3 bits are needed, use the low half of 5^q when they may be off by one
+    const uint64_t* pow5 = Pow5_128(q);
+    const uint64_t kPrecisionMask = RAPIDJSON_UINT64_C2(0xFFFFFFFF, 0xFFFFFFFF) >> (kSignificandSize + 3);
+    uint64_t high;
+    uint64_t low = Multiply128(w, pow5[0], &high);
+    if ((high & kPrecisionMask) == kPrecisionMask) {
+        uint64_t high2;
+        Multiply128(w, pow5[1], &high2);
+        low += high2;
+        if (high2 > low)
+            high++;
+        if (low == RAPIDJSON_UINT64_C2(0xFFFFFFFF, 0xFFFFFFFF) && (q < -27 || q > 55))
+            return false;
+    }
+
+    const int upperBit = static_cast<int>(high >> 63);
+    const int shift = upperBit + 64 - kSignificandSize - 3;
+    uint64_t mantissa = high >> shift;
+    // floor(log2(10^q)) + 63 + 1023
+    int power2 = (((152170 + 65536) * q) >> 16) + 63 + upperBit - lz + 1023;
+
+    if (power2 <= 0) { // subnormal
+        if (-power2 + 1 >= 64) {
+            *result = 0.0;
+            return true;
+        }
+        mantissa >>= -power2 + 1;
+        mantissa += (mantissa & 1);
+        mantissa >>= 1;
+        power2 = (mantissa < (static_cast<uint64_t>(1) << kSignificandSize)) ? 0 : 1;
+    }
+    else {
+        // Exactly halfway: only possible for small |q|, round to even
+        if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == high)
+            mantissa &= ~static_cast<uint64_t>(1);
+        mantissa += (mantissa & 1);
+        mantissa >>= 1;
+        if (mantissa >= (static_cast<uint64_t>(2) << kSignificandSize)) {
+            mantissa = static_cast<uint64_t>(1) << kSignificandSize;
+            power2++;
+        }
+        mantissa &= ~(static_cast<uint64_t>(1) << kSignificandSize);
+        if (power2 >= kInfinitePower) {
+            *result = std::numeric_limits<double>::infinity();
+            return true;
+        }
+    }
+
+    *result = Double(mantissa | (static_cast<uint64_t>(power2) << kSignificandSize)).Value();
+    return true;
+}
+
 // Compute an approximation and see if it is within 1/2 ULP
 inline bool StrtodDiyFp(const char* decimals, int dLen, int dExp, double* result) {
     uint64_t significand = 0;
@@ -277,6 +363,29 @@ inline double StrtodFullPrecision(double d, int p, const char* decimals, size_t
     if (dLen + dExp > 309)
         return std::numeric_limits<double>::infinity();
 
+    // Up to 19 digits are exact in uint64_t. Longer inputs are truncated to 19 digits,
+    // and the result is only taken when rounding the truncated and the incremented significand agree.
+    const int kMaxUint64Digit = 19;
+    const int wLen = dLen < kMaxUint64Digit ? dLen : kMaxUint64Digit;
+    uint64_t w = 0;
+    int i = 0;
+#if RAPIDJSON_ENDIAN == RAPIDJSON_LITTLEENDIAN
+    for (; i + 8 <= wLen; i += 8)
+        w = w * 100000000u + ParseEightDigits(decimals + i);
+#endif
+    for (; i < wLen; i++)
+        w = w * 10u + static_cast<unsigned>(decimals[i] - '0');
+    if (dLen <= kMaxUint64Digit) {
+        if (StrtodEiselLemire(w, dExp, &result))
+            return result;
+    }
+    else {
+        double upper;
+        const int wExp = dExp + dLen - kMaxUint64Digit;
+        if (StrtodEiselLemire(w, wExp, &result) && StrtodEiselLemire(w + 1, wExp, &upper) && Double(result).Uint64Value() == Double(upper).Uint64Value())
+            return result;
+    }
+
     if (StrtodDiyFp(decimals, dLen, dExp, &result))
         return result;
 
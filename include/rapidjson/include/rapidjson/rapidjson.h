@@ -353,6 +353,26 @@
 #define RAPIDJSON_SIMD
 #endif
 
+///////////////////////////////////////////////////////////////////////////////
+// RAPIDJSON_DISPATCH
+
+/*! \def RAPIDJSON_DISPATCH
+    \ingroup RAPIDJSON_CONFIG
+    \brief Select SSE2/SSE4.2/AVX2/AVX-512 kernels at run time.
+
+    When none of the SIMD symbols above is defined, GCC and clang builds for
+    x86 detect the CPU features on first use and pick the widest whitespace
+    skipping and string scanning kernels available, so a single binary gets
+    SIMD speed on every host without \c -march.
+
+    Define \c RAPIDJSON_NO_DISPATCH to keep the portable scalar code.
+*/
+#if !defined(RAPIDJSON_SIMD) && !defined(RAPIDJSON_DISPATCH) && !defined(RAPIDJSON_NO_DISPATCH) \
+    && (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define RAPIDJSON_DISPATCH
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 // RAPIDJSON_NO_SIZETYPEDEFINE
 
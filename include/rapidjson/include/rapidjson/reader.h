@@ -23,7 +23,9 @@
 #include "internal/meta.h"
 #include "internal/stack.h"
 #include "internal/strtod.h"
+#include "internal/cpu.h"
 #include <limits>
+#include <cstring>
 
 #if defined(RAPIDJSON_SIMD) && defined(_MSC_VER)
 #include <intrin.h>
@@ -498,7 +500,150 @@ inline const char *SkipWhitespace_SIMD(const char* p, const char* end) {
 
 #endif // RAPIDJSON_NEON
 
-#ifdef RAPIDJSON_SIMD
+#ifdef RAPIDJSON_DISPATCH
+namespace internal {
+
+inline bool IsWhitespace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// Each kernel skips whitespace up to end. A null end means a null-terminated
+// string: the pointer is aligned first, so that aligned loads never cross into
+// a page past the terminator.
+
+RAPIDJSON_TARGET("sse2") inline unsigned NonWhitespaceSSE2(__m128i s) {
+    __m128i x = _mm_cmpeq_epi8(s, _mm_set1_epi8(' '));
+    x = _mm_or_si128(x, _mm_cmpeq_epi8(s, _mm_set1_epi8('\n')));
+    x = _mm_or_si128(x, _mm_cmpeq_epi8(s, _mm_set1_epi8('\r')));
+    x = _mm_or_si128(x, _mm_cmpeq_epi8(s, _mm_set1_epi8('\t')));
+    return ~static_cast<unsigned>(_mm_movemask_epi8(x)) & 0xFFFFu;
+}
+
+RAPIDJSON_TARGET("sse2") RAPIDJSON_NO_SANITIZE_ADDRESS inline const char* SkipWhitespaceSSE2(const char* p, const char* end) {
+    if (!end) {
+        for (; reinterpret_cast<size_t>(p) & 15; ++p)
+            if (!IsWhitespace(*p))
+                return p;
+        for (;; p += 16)
+            if (unsigned r = NonWhitespaceSSE2(_mm_load_si128(reinterpret_cast<const __m128i *>(p))))
+                return p + __builtin_ctz(r);
+    }
+    for (; end - p >= 16; p += 16)
+        if (unsigned r = NonWhitespaceSSE2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))))
+            return p + __builtin_ctz(r);
+    return SkipWhitespace(p, end);
+}
+
+RAPIDJSON_TARGET("sse4.2") inline int NonWhitespaceSSE42(__m128i s) {
+    static const char whitespace[16] = " \n\r\t";
+    const __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&whitespace[0]));
+    return _mm_cmpistri(w, s, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT | _SIDD_NEGATIVE_POLARITY);
+}
+
+RAPIDJSON_TARGET("sse4.2") RAPIDJSON_NO_SANITIZE_ADDRESS inline const char* SkipWhitespaceSSE42(const char* p, const char* end) {
+    if (!end) {
+        for (; reinterpret_cast<size_t>(p) & 15; ++p)
+            if (!IsWhitespace(*p))
+                return p;
+        for (;; p += 16) {
+            const int r = NonWhitespaceSSE42(_mm_load_si128(reinterpret_cast<const __m128i *>(p)));
+            if (r != 16)
+                return p + r;
+        }
+    }
+    for (; end - p >= 16; p += 16) {
+        const int r = NonWhitespaceSSE42(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+        if (r != 16)
+            return p + r;
+    }
+    return SkipWhitespace(p, end);
+}
+
+RAPIDJSON_TARGET("avx2") inline unsigned NonWhitespaceAVX2(__m256i s) {
+    __m256i x = _mm256_cmpeq_epi8(s, _mm256_set1_epi8(' '));
+    x = _mm256_or_si256(x, _mm256_cmpeq_epi8(s, _mm256_set1_epi8('\n')));
+    x = _mm256_or_si256(x, _mm256_cmpeq_epi8(s, _mm256_set1_epi8('\r')));
+    x = _mm256_or_si256(x, _mm256_cmpeq_epi8(s, _mm256_set1_epi8('\t')));
+    return ~static_cast<unsigned>(_mm256_movemask_epi8(x));
+}
+
+RAPIDJSON_TARGET("avx2") RAPIDJSON_NO_SANITIZE_ADDRESS inline const char* SkipWhitespaceAVX2(const char* p, const char* end) {
+    if (!end) {
+        for (; reinterpret_cast<size_t>(p) & 31; ++p)
+            if (!IsWhitespace(*p))
+                return p;
+        for (;; p += 32)
+            if (unsigned r = NonWhitespaceAVX2(_mm256_load_si256(reinterpret_cast<const __m256i *>(p))))
+                return p + __builtin_ctz(r);
+    }
+    for (; end - p >= 32; p += 32)
+        if (unsigned r = NonWhitespaceAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))))
+            return p + __builtin_ctz(r);
+    return SkipWhitespaceSSE2(p, end);
+}
+
+RAPIDJSON_TARGET("avx512f,avx512bw") inline uint64_t NonWhitespaceAVX512(__m512i s) {
+    return ~(_mm512_cmpeq_epi8_mask(s, _mm512_set1_epi8(' ')) | _mm512_cmpeq_epi8_mask(s, _mm512_set1_epi8('\n')) |
+        _mm512_cmpeq_epi8_mask(s, _mm512_set1_epi8('\r')) | _mm512_cmpeq_epi8_mask(s, _mm512_set1_epi8('\t')));
+}
+
+RAPIDJSON_TARGET("avx512f,avx512bw") RAPIDJSON_NO_SANITIZE_ADDRESS inline const char* SkipWhitespaceAVX512(const char* p, const char* end) {
+    if (!end) {
+        for (; reinterpret_cast<size_t>(p) & 63; ++p)
+            if (!IsWhitespace(*p))
+                return p;
+        for (;; p += 64)
+            if (uint64_t r = NonWhitespaceAVX512(_mm512_load_si512(reinterpret_cast<const void *>(p))))
+                return p + __builtin_ctzll(r);
+    }
+    for (; end - p >= 64; p += 64)
+        if (uint64_t r = NonWhitespaceAVX512(_mm512_loadu_si512(reinterpret_cast<const void *>(p))))
+            return p + __builtin_ctzll(r);
+
+    // Masked load of the tail, bytes past end are neither read nor counted.
+    const __mmask64 valid = (uint64_t(1) << (end - p)) - 1;
+    if (uint64_t r = NonWhitespaceAVX512(_mm512_maskz_loadu_epi8(valid, p)) & valid)
+        return p + __builtin_ctzll(r);
+    return end;
+}
+
+inline const char* SkipWhitespaceDispatch(const char* p, const char* end) {
+    switch (GetCpuLevel()) {
+    case kCpuAVX512: return SkipWhitespaceAVX512(p, end);
+    case kCpuAVX2:   return SkipWhitespaceAVX2(p, end);
+    case kCpuSSE42:  return SkipWhitespaceSSE42(p, end);
+    case kCpuSSE2:   return SkipWhitespaceSSE2(p, end);
+    default:
+        if (end)
+            return SkipWhitespace(p, end);
+        while (IsWhitespace(*p))
+            ++p;
+        return p;
+    }
+}
+
+} // namespace internal
+
+//! Skip whitespace with the kernel selected at run time, see RAPIDJSON_DISPATCH.
+inline const char *SkipWhitespace_SIMD(const char* p) {
+    // Fast return for short runs, the common case between tokens
+    if (!internal::IsWhitespace(*p))
+        return p;
+    if (!internal::IsWhitespace(*++p))
+        return p;
+    return internal::SkipWhitespaceDispatch(p, 0);
+}
+
+inline const char *SkipWhitespace_SIMD(const char* p, const char* end) {
+    if (p == end || !internal::IsWhitespace(*p))
+        return p;
+    if (++p == end || !internal::IsWhitespace(*p))
+        return p;
+    return internal::SkipWhitespaceDispatch(p, end);
+}
+#endif // RAPIDJSON_DISPATCH
+
+#if defined(RAPIDJSON_SIMD) || defined(RAPIDJSON_DISPATCH)
 //! Template function specialization for InsituStringStream
 template<> inline void SkipWhitespace(InsituStringStream& is) {
     is.src_ = const_cast<char*>(SkipWhitespace_SIMD(is.src_));
@@ -512,7 +657,277 @@ template<> inline void SkipWhitespace(StringStream& is) {
 template<> inline void SkipWhitespace(EncodedInputStream<UTF8<>, MemoryStream>& is) {
     is.is_.src_ = SkipWhitespace_SIMD(is.is_.src_, is.is_.end_);
 }
-#endif // RAPIDJSON_SIMD
+
+//! Template function specialization for MemoryStream
+template<> inline void SkipWhitespace(MemoryStream& is) {
+    is.src_ = SkipWhitespace_SIMD(is.src_, is.end_);
+}
+#endif // RAPIDJSON_SIMD || RAPIDJSON_DISPATCH
+
+///////////////////////////////////////////////////////////////////////////////
+// UTF-8 string scanning for kParseValidateEncodingFlag
+
+namespace internal {
+
+//! '"', '\\' and control characters end a run of plain string content.
+inline bool IsStringStop(unsigned char c) {
+    return c < 0x20 || c == '\"' || c == '\\';
+}
+
+inline const char* ScanAsciiScalar(const char* p, const char* end) {
+    while (p != end && !IsStringStop(static_cast<unsigned char>(*p)) && !(*p & 0x80))
+        ++p;
+    return p;
+}
+
+inline const char* FindStringStopScalar(const char* p) {
+    while (!IsStringStop(static_cast<unsigned char>(*p)))
+        ++p;
+    return p;
+}
+
+//! Move back from p to the lead byte of the character p is inside of, so that a scalar decoder can resume there.
+inline const char* Utf8Boundary(const char* start, const char* p) {
+    const char* q = p;
+    while (q != start && p - q < 3 && (static_cast<unsigned char>(q[-1]) & 0xC0) == 0x80)
+        --q;
+    if (q != start && static_cast<unsigned char>(q[-1]) >= 0xC0)
+        --q;
+    return q;
+}
+
+#ifdef RAPIDJSON_DISPATCH
+// UTF-8 validation by table lookup (Keiser and Lemire, "Validating UTF-8 In
+// Less Than One Instruction Per Byte"). Each byte is checked against the one
+// before it through three 16 entry tables, which mark every error of a two
+// byte window, while the third and fourth bytes of long sequences are checked
+// by saturating subtraction. The run stops at the first '"', '\\' or control
+// character. On an error or an incomplete tail, the kernels return the start
+// of the offending character, and the caller validates the rest one code
+// point at a time. Errors are therefore reported exactly as before.
+
+enum {
+    kUtf8TooShort = 1 << 0,
+    kUtf8TooLong = 1 << 1,
+    kUtf8Overlong3 = 1 << 2,
+    kUtf8TooLarge = 1 << 3,
+    kUtf8Surrogate = 1 << 4,
+    kUtf8Overlong2 = 1 << 5,
+    kUtf8TooLarge1000 = 1 << 6,
+    kUtf8Overlong4 = 1 << 6,
+    kUtf8TwoConts = 1 << 7,
+    kUtf8Carry = kUtf8TooShort | kUtf8TooLong | kUtf8TwoConts
+};
+
+#define RAPIDJSON_UTF8_BYTE_1_HIGH \
+    kUtf8TooLong, kUtf8TooLong, kUtf8TooLong, kUtf8TooLong, \
+    kUtf8TooLong, kUtf8TooLong, kUtf8TooLong, kUtf8TooLong, \
+    kUtf8TwoConts, kUtf8TwoConts, kUtf8TwoConts, kUtf8TwoConts, \
+    kUtf8TooShort | kUtf8Overlong2, \
+    kUtf8TooShort, \
+    kUtf8TooShort | kUtf8Overlong3 | kUtf8Surrogate, \
+    kUtf8TooShort | kUtf8TooLarge | kUtf8TooLarge1000 | kUtf8Overlong4
+#define RAPIDJSON_UTF8_BYTE_1_LOW \
+    kUtf8Carry | kUtf8Overlong3 | kUtf8Overlong2 | kUtf8Overlong4, \
+    kUtf8Carry | kUtf8Overlong2, \
+    kUtf8Carry, \
+    kUtf8Carry, \
+    kUtf8Carry | kUtf8TooLarge, \
+    kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000, \
+    kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000, \
+    kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000, \
+    kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000, \
+    kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000, \
+    kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000, \
+    kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000, \
+    kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000, \
+    kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000 | kUtf8Surrogate, \
+    kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000, \
+    kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000
+#define RAPIDJSON_UTF8_BYTE_2_HIGH \
+    kUtf8TooShort, kUtf8TooShort, kUtf8TooShort, kUtf8TooShort, \
+    kUtf8TooShort, kUtf8TooShort, kUtf8TooShort, kUtf8TooShort, \
+    kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Overlong3 | kUtf8TooLarge1000 | kUtf8Overlong4, \
+    kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Overlong3 | kUtf8TooLarge, \
+    kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Surrogate | kUtf8TooLarge, \
+    kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Surrogate | kUtf8TooLarge, \
+    kUtf8TooShort, kUtf8TooShort, kUtf8TooShort, kUtf8TooShort
+
+RAPIDJSON_TARGET("sse2") RAPIDJSON_NO_SANITIZE_ADDRESS inline const char* FindStringStopSSE2(const char* p) {
+    const __m128i dq = _mm_set1_epi8('\"');
+    const __m128i bs = _mm_set1_epi8('\\');
+    const __m128i sp = _mm_set1_epi8(0x1F);
+
+    // Aligned loads never cross into the page after the terminator
+    for (; reinterpret_cast<size_t>(p) & 15; ++p)
+        if (IsStringStop(static_cast<unsigned char>(*p)))
+            return p;
+    for (;; p += 16) {
+        const __m128i s = _mm_load_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i x = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(s, dq), _mm_cmpeq_epi8(s, bs)),
+            _mm_cmpeq_epi8(_mm_max_epu8(s, sp), sp));
+        if (unsigned r = static_cast<unsigned>(_mm_movemask_epi8(x)))
+            return p + __builtin_ctz(r);
+    }
+}
+
+//! Without a byte shuffle only ASCII runs are taken, the rest is left to the scalar decoder.
+RAPIDJSON_TARGET("sse2") inline const char* ScanValidUtf8SSE2(const char* p, const char* end) {
+    const __m128i dq = _mm_set1_epi8('\"');
+    const __m128i bs = _mm_set1_epi8('\\');
+    const __m128i sp = _mm_set1_epi8(0x1F);
+
+    for (; end - p >= 16; p += 16) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i x = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(s, dq), _mm_cmpeq_epi8(s, bs)),
+            _mm_cmpeq_epi8(_mm_max_epu8(s, sp), sp));
+        if (unsigned r = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(x, s))))
+            return p + __builtin_ctz(r);
+    }
+    return ScanAsciiScalar(p, end);
+}
+
+RAPIDJSON_TARGET("sse4.2") inline __m128i Utf8ErrorsSSE42(__m128i input, __m128i prev) {
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i prev1 = _mm_alignr_epi8(input, prev, 15);
+    const __m128i byte1High = _mm_shuffle_epi8(_mm_setr_epi8(RAPIDJSON_UTF8_BYTE_1_HIGH),
+        _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble));
+    const __m128i byte1Low = _mm_shuffle_epi8(_mm_setr_epi8(RAPIDJSON_UTF8_BYTE_1_LOW),
+        _mm_and_si128(prev1, nibble));
+    const __m128i byte2High = _mm_shuffle_epi8(_mm_setr_epi8(RAPIDJSON_UTF8_BYTE_2_HIGH),
+        _mm_and_si128(_mm_srli_epi16(input, 4), nibble));
+    const __m128i special = _mm_and_si128(_mm_and_si128(byte1High, byte1Low), byte2High);
+
+    // Only 111_____ two bytes back or 1111____ three bytes back reach 0x80
+    const __m128i third = _mm_subs_epu8(_mm_alignr_epi8(input, prev, 14), _mm_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    const __m128i fourth = _mm_subs_epu8(_mm_alignr_epi8(input, prev, 13), _mm_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    const __m128i must23 = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8(static_cast<char>(0x80)));
+    return _mm_xor_si128(must23, special);
+}
+
+RAPIDJSON_TARGET("sse4.2") inline const char* ScanValidUtf8SSE42(const char* p, const char* end) {
+    const char* start = p;
+    const __m128i dq = _mm_set1_epi8('\"');
+    const __m128i bs = _mm_set1_epi8('\\');
+    const __m128i sp = _mm_set1_epi8(0x1F);
+    const __m128i index = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m128i incompleteMax = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    __m128i prev = _mm_setzero_si128();
+    __m128i incomplete = _mm_setzero_si128();
+
+    for (; end - p >= 16; p += 16) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i x = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(s, dq), _mm_cmpeq_epi8(s, bs)),
+            _mm_cmpeq_epi8(_mm_max_epu8(s, sp), sp));
+        const unsigned r = static_cast<unsigned>(_mm_movemask_epi8(x));
+        const int stop = r ? __builtin_ctz(r) : 16;
+        if (r) // zero from the stop on, an unfinished character before it then shows as too short
+            s = _mm_and_si128(s, _mm_cmpgt_epi8(_mm_set1_epi8(static_cast<char>(stop)), index));
+
+        const __m128i error = _mm_movemask_epi8(s) ? Utf8ErrorsSSE42(s, prev) : incomplete;
+        if (!_mm_testz_si128(error, error))
+            return Utf8Boundary(start, p);
+        if (r)
+            return p + stop;
+        incomplete = _mm_subs_epu8(s, incompleteMax);
+        prev = s;
+    }
+    return _mm_testz_si128(incomplete, incomplete) ? p : Utf8Boundary(start, p);
+}
+
+RAPIDJSON_TARGET("avx2") inline __m256i Utf8PrevAVX2(__m256i input, __m256i prev, int n) {
+    const __m256i shifted = _mm256_permute2x128_si256(prev, input, 0x21);
+    switch (n) {
+    case 1: return _mm256_alignr_epi8(input, shifted, 15);
+    case 2: return _mm256_alignr_epi8(input, shifted, 14);
+    default: return _mm256_alignr_epi8(input, shifted, 13);
+    }
+}
+
+RAPIDJSON_TARGET("avx2") inline __m256i Utf8ErrorsAVX2(__m256i input, __m256i prev) {
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i prev1 = Utf8PrevAVX2(input, prev, 1);
+    const __m256i byte1High = _mm256_shuffle_epi8(_mm256_setr_epi8(RAPIDJSON_UTF8_BYTE_1_HIGH, RAPIDJSON_UTF8_BYTE_1_HIGH),
+        _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+    const __m256i byte1Low = _mm256_shuffle_epi8(_mm256_setr_epi8(RAPIDJSON_UTF8_BYTE_1_LOW, RAPIDJSON_UTF8_BYTE_1_LOW),
+        _mm256_and_si256(prev1, nibble));
+    const __m256i byte2High = _mm256_shuffle_epi8(_mm256_setr_epi8(RAPIDJSON_UTF8_BYTE_2_HIGH, RAPIDJSON_UTF8_BYTE_2_HIGH),
+        _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+    const __m256i special = _mm256_and_si256(_mm256_and_si256(byte1High, byte1Low), byte2High);
+
+    const __m256i third = _mm256_subs_epu8(Utf8PrevAVX2(input, prev, 2), _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    const __m256i fourth = _mm256_subs_epu8(Utf8PrevAVX2(input, prev, 3), _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    const __m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+    return _mm256_xor_si256(must23, special);
+}
+
+RAPIDJSON_TARGET("avx2") inline const char* ScanValidUtf8AVX2(const char* p, const char* end) {
+    const char* start = p;
+    const __m256i dq = _mm256_set1_epi8('\"');
+    const __m256i bs = _mm256_set1_epi8('\\');
+    const __m256i sp = _mm256_set1_epi8(0x1F);
+    const __m256i index = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+        16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31);
+    const __m256i incompleteMax = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    __m256i prev = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+
+    for (; end - p >= 32; p += 32) {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        const __m256i x = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(s, dq), _mm256_cmpeq_epi8(s, bs)),
+            _mm256_cmpeq_epi8(_mm256_max_epu8(s, sp), sp));
+        const unsigned r = static_cast<unsigned>(_mm256_movemask_epi8(x));
+        const int stop = r ? __builtin_ctz(r) : 32;
+        if (r)
+            s = _mm256_and_si256(s, _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(stop)), index));
+
+        const __m256i error = _mm256_movemask_epi8(s) ? Utf8ErrorsAVX2(s, prev) : incomplete;
+        if (!_mm256_testz_si256(error, error))
+            return Utf8Boundary(start, p);
+        if (r)
+            return p + stop;
+        incomplete = _mm256_subs_epu8(s, incompleteMax);
+        prev = s;
+    }
+    if (!_mm256_testz_si256(incomplete, incomplete))
+        return Utf8Boundary(start, p);
+    return end - p >= 16 ? ScanValidUtf8SSE42(p, end) : p;
+}
+
+#undef RAPIDJSON_UTF8_BYTE_1_HIGH
+#undef RAPIDJSON_UTF8_BYTE_1_LOW
+#undef RAPIDJSON_UTF8_BYTE_2_HIGH
+#endif // RAPIDJSON_DISPATCH
+
+//! Find the first '"', '\\' or control character of a null-terminated string.
+inline const char* FindStringStop(const char* p) {
+#ifdef RAPIDJSON_DISPATCH
+    if (GetCpuLevel() >= kCpuSSE2)
+        return FindStringStopSSE2(p);
+#endif
+    return FindStringStopScalar(p);
+}
+
+//! Longest run of [p, end) that is valid UTF-8 and holds no '"', '\\' or control character.
+/*! The run ends on a character boundary, what follows it is left to the caller.
+*/
+inline const char* ScanValidUtf8(const char* p, const char* end) {
+#ifdef RAPIDJSON_DISPATCH
+    switch (GetCpuLevel()) {
+    case kCpuAVX512:
+    case kCpuAVX2:  return ScanValidUtf8AVX2(p, end);
+    case kCpuSSE42: return ScanValidUtf8SSE42(p, end);
+    case kCpuSSE2:  return ScanValidUtf8SSE2(p, end);
+    default: break;
+    }
+#endif
+    return ScanAsciiScalar(p, end);
+}
+
+} // namespace internal
 
 ///////////////////////////////////////////////////////////////////////////////
 // GenericReader
@@ -999,10 +1414,15 @@ private:
 #undef Z16
 //!@endcond
 
+        // End of the current run for ScanCopyValidString(), kept across iterations so that
+        // each stretch between escapes is searched once however often the scan stops early.
+        const char* stop = 0;
         for (;;) {
             // Scan and copy string before "\\\"" or < 0x20. This is an optional optimzation.
             if (!(parseFlags & kParseValidateEncodingFlag))
                 ScanCopyUnescapedString(is, os);
+            else
+                ScanCopyValidString(is, os, stop);
 
             Ch c = is.Peek();
             if (RAPIDJSON_UNLIKELY(c == '\\')) {    // Escape
@@ -1058,6 +1478,57 @@ private:
             // Do nothing for generic version
     }
 
+    // Scan and copy valid UTF-8 before "\\\"" or < 0x20, when validating encoding.
+    // stop caches the next such character of a null-terminated stream, null before the first call.
+    template<typename InputStream, typename OutputStream>
+    static RAPIDJSON_FORCEINLINE void ScanCopyValidString(InputStream&, OutputStream&, const char*&) {
+            // Do nothing for generic version
+    }
+
+    static RAPIDJSON_FORCEINLINE bool IsUTF8ToUTF8() {
+        return internal::IsSame<SourceEncoding, UTF8<> >::Value && internal::IsSame<TargetEncoding, UTF8<> >::Value;
+    }
+
+    // MemoryStream -> StackStream<char>
+    static RAPIDJSON_FORCEINLINE void ScanCopyValidString(MemoryStream& is, StackStream<char>& os, const char*&) {
+        if (!IsUTF8ToUTF8())
+            return;
+        const char* p = is.src_;
+        const char* q = internal::ScanValidUtf8(p, is.end_);
+        if (q != p) {
+            std::memcpy(os.Push(static_cast<SizeType>(q - p)), p, static_cast<size_t>(q - p));
+            is.src_ = q;
+        }
+    }
+
+    // StringStream -> StackStream<char>
+    static RAPIDJSON_FORCEINLINE void ScanCopyValidString(StringStream& is, StackStream<char>& os, const char*& stop) {
+        if (!IsUTF8ToUTF8())
+            return;
+        const char* p = is.src_;
+        if (!stop || p > stop)
+            stop = internal::FindStringStop(p);
+        const char* q = internal::ScanValidUtf8(p, stop);
+        if (q != p) {
+            std::memcpy(os.Push(static_cast<SizeType>(q - p)), p, static_cast<size_t>(q - p));
+            is.src_ = q;
+        }
+    }
+
+    // InsituStringStream -> InsituStringStream
+    static RAPIDJSON_FORCEINLINE void ScanCopyValidString(InsituStringStream& is, InsituStringStream& os, const char*& stop) {
+        if (!IsUTF8ToUTF8())
+            return;
+        char* p = is.src_;
+        if (!stop || p > stop)
+            stop = internal::FindStringStop(p);
+        char* q = p + (internal::ScanValidUtf8(p, stop) - p);
+        if (q != p) {
+            std::memmove(os.Push(static_cast<size_t>(q - p)), p, static_cast<size_t>(q - p));
+            is.src_ = q;
+        }
+    }
+
 #if defined(RAPIDJSON_SSE2) || defined(RAPIDJSON_SSE42)
     // StringStream -> StackStream<char>
     static RAPIDJSON_FORCEINLINE void ScanCopyUnescapedString(StringStream& is, StackStream<char>& os) {
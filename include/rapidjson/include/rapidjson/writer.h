@@ -22,7 +22,9 @@
 #include "internal/dtoa.h"
 #include "internal/itoa.h"
 #include "stringbuffer.h"
+#include "internal/cpu.h"
 #include <new>      // placement new
+#include <cstring>  // memcpy
 
 #if defined(RAPIDJSON_SIMD) && defined(_MSC_VER)
 #include <intrin.h>
@@ -66,6 +68,7 @@ enum WriteFlag {
     kWriteNoFlags = 0,              //!< No flags are set.
     kWriteValidateEncodingFlag = 1, //!< Validate encoding of JSON strings.
     kWriteNanAndInfFlag = 2,        //!< Allow writing of Infinity, -Infinity and NaN.
+    kWriteShortestDoubleFlag = 4,   //!< Write doubles as the shortest decimal that round-trips (Dragonbox) instead of Grisu2.
     kWriteDefaultFlags = RAPIDJSON_WRITE_DEFAULT_FLAGS  //!< Default write flags. Can be customized by defining RAPIDJSON_WRITE_DEFAULT_FLAGS
 };
 
@@ -366,7 +369,7 @@ protected:
         }
 
         char buffer[25];
-        char* end = internal::dtoa(d, buffer, maxDecimalPlaces_);
+        char* end = internal::dtoa(d, buffer, maxDecimalPlaces_, (writeFlags & kWriteShortestDoubleFlag) != 0);
         PutReserve(*os_, static_cast<size_t>(end - buffer));
         for (char* p = buffer; p != end; ++p)
             PutUnsafe(*os_, static_cast<typename OutputStream::Ch>(*p));
@@ -564,11 +567,158 @@ inline bool Writer<StringBuffer>::WriteDouble(double d) {
     }
     
     char *buffer = os_->Push(25);
-    char* end = internal::dtoa(d, buffer, maxDecimalPlaces_);
+    char* end = internal::dtoa(d, buffer, maxDecimalPlaces_, (kWriteDefaultFlags & kWriteShortestDoubleFlag) != 0);
     os_->Pop(static_cast<size_t>(25 - (end - buffer)));
     return true;
 }
 
+namespace internal {
+
+inline bool NeedsEscape(unsigned char c) {
+    return c < 0x20 || c == '\"' || c == '\\';
+}
+
+//! Write the escape sequence of a character for which NeedsEscape() holds, as Writer::WriteString() does.
+/*! Table driven, so that mixed quotes and control characters do not cost a branch each.
+    \note Always stores 6 characters.
+*/
+inline char* PutEscape(char* out, unsigned char c) {
+    static const struct { char s[6]; unsigned char length; } escapes[34] = {
+        // 0x00~0x1F, then '"' and '\\'
+        { { '\\', 'u', '0', '0', '0', '0' }, 6 }, { { '\\', 'u', '0', '0', '0', '1' }, 6 },
+        { { '\\', 'u', '0', '0', '0', '2' }, 6 }, { { '\\', 'u', '0', '0', '0', '3' }, 6 },
+        { { '\\', 'u', '0', '0', '0', '4' }, 6 }, { { '\\', 'u', '0', '0', '0', '5' }, 6 },
+        { { '\\', 'u', '0', '0', '0', '6' }, 6 }, { { '\\', 'u', '0', '0', '0', '7' }, 6 },
+        { { '\\', 'b', 0, 0, 0, 0 }, 2 }, { { '\\', 't', 0, 0, 0, 0 }, 2 },
+        { { '\\', 'n', 0, 0, 0, 0 }, 2 }, { { '\\', 'u', '0', '0', '0', 'B' }, 6 },
+        { { '\\', 'f', 0, 0, 0, 0 }, 2 }, { { '\\', 'r', 0, 0, 0, 0 }, 2 },
+        { { '\\', 'u', '0', '0', '0', 'E' }, 6 }, { { '\\', 'u', '0', '0', '0', 'F' }, 6 },
+        { { '\\', 'u', '0', '0', '1', '0' }, 6 }, { { '\\', 'u', '0', '0', '1', '1' }, 6 },
+        { { '\\', 'u', '0', '0', '1', '2' }, 6 }, { { '\\', 'u', '0', '0', '1', '3' }, 6 },
+        { { '\\', 'u', '0', '0', '1', '4' }, 6 }, { { '\\', 'u', '0', '0', '1', '5' }, 6 },
+        { { '\\', 'u', '0', '0', '1', '6' }, 6 }, { { '\\', 'u', '0', '0', '1', '7' }, 6 },
+        { { '\\', 'u', '0', '0', '1', '8' }, 6 }, { { '\\', 'u', '0', '0', '1', '9' }, 6 },
+        { { '\\', 'u', '0', '0', '1', 'A' }, 6 }, { { '\\', 'u', '0', '0', '1', 'B' }, 6 },
+        { { '\\', 'u', '0', '0', '1', 'C' }, 6 }, { { '\\', 'u', '0', '0', '1', 'D' }, 6 },
+        { { '\\', 'u', '0', '0', '1', 'E' }, 6 }, { { '\\', 'u', '0', '0', '1', 'F' }, 6 },
+        { { '\\', '\"', 0, 0, 0, 0 }, 2 }, { { '\\', '\\', 0, 0, 0, 0 }, 2 }
+    };
+    const unsigned i = c < 0x20 ? c : (c == '\"' ? 0x20u : 0x21u);
+    std::memcpy(out, escapes[i].s, 6);
+    return out + escapes[i].length;
+}
+
+inline char* WriteEscapedScalar(char* out, const char* p, const char* end) {
+    for (; p != end; ++p) {
+        const unsigned char c = static_cast<unsigned char>(*p);
+        if (RAPIDJSON_UNLIKELY(NeedsEscape(c)))
+            out = PutEscape(out, c);
+        else
+            *out++ = static_cast<char>(c);
+    }
+    return out;
+}
+
+#ifdef RAPIDJSON_DISPATCH
+// Each kernel stores a whole block, then, if the block holds a character to
+// escape, keeps the bytes before it, writes the escape and reloads right after
+// it. Runs with quotes or control characters stay on the vector path.
+
+RAPIDJSON_TARGET("sse2") inline char* WriteEscapedSSE2(char* out, const char* p, const char* end) {
+    const __m128i dq = _mm_set1_epi8('\"');
+    const __m128i bs = _mm_set1_epi8('\\');
+    const __m128i sp = _mm_set1_epi8(0x1F);
+
+    while (end - p >= 16) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i t1 = _mm_cmpeq_epi8(s, dq);
+        const __m128i t2 = _mm_cmpeq_epi8(s, bs);
+        const __m128i t3 = _mm_cmpeq_epi8(_mm_max_epu8(s, sp), sp); // s < 0x20 <=> max(s, 0x1F) == 0x1F
+        const unsigned r = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(t1, t2), t3)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), s);
+        if (RAPIDJSON_LIKELY(r == 0)) {
+            p += 16;
+            out += 16;
+            continue;
+        }
+        const int i = __builtin_ctz(r);
+        out = PutEscape(out + i, static_cast<unsigned char>(p[i]));
+        p += i + 1;
+    }
+    return WriteEscapedScalar(out, p, end);
+}
+
+RAPIDJSON_TARGET("avx2") inline char* WriteEscapedAVX2(char* out, const char* p, const char* end) {
+    const __m256i dq = _mm256_set1_epi8('\"');
+    const __m256i bs = _mm256_set1_epi8('\\');
+    const __m256i sp = _mm256_set1_epi8(0x1F);
+
+    while (end - p >= 32) {
+        const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        const __m256i t1 = _mm256_cmpeq_epi8(s, dq);
+        const __m256i t2 = _mm256_cmpeq_epi8(s, bs);
+        const __m256i t3 = _mm256_cmpeq_epi8(_mm256_max_epu8(s, sp), sp);
+        const unsigned r = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(t1, t2), t3)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), s);
+        if (RAPIDJSON_LIKELY(r == 0)) {
+            p += 32;
+            out += 32;
+            continue;
+        }
+        const int i = __builtin_ctz(r);
+        out = PutEscape(out + i, static_cast<unsigned char>(p[i]));
+        p += i + 1;
+    }
+    return WriteEscapedSSE2(out, p, end);
+}
+
+RAPIDJSON_TARGET("avx512f,avx512bw") inline char* WriteEscapedAVX512(char* out, const char* p, const char* end) {
+    const __m512i dq = _mm512_set1_epi8('\"');
+    const __m512i bs = _mm512_set1_epi8('\\');
+    const __m512i sp = _mm512_set1_epi8(0x1F);
+
+    while (p != end) {
+        // The tail is loaded and stored under a mask, bytes past end are not touched
+        const uint64_t n = static_cast<uint64_t>(end - p);
+        const __mmask64 valid = n >= 64 ? ~__mmask64(0) : (uint64_t(1) << n) - 1;
+        const __m512i s = _mm512_maskz_loadu_epi8(valid, p);
+        const uint64_t r = (_mm512_cmpeq_epi8_mask(s, dq) | _mm512_cmpeq_epi8_mask(s, bs) |
+            _mm512_cmple_epu8_mask(s, sp)) & valid;
+        _mm512_mask_storeu_epi8(out, valid, s);
+        if (RAPIDJSON_LIKELY(r == 0)) {
+            const size_t step = n >= 64 ? 64 : static_cast<size_t>(n);
+            p += step;
+            out += step;
+            continue;
+        }
+        const int i = __builtin_ctzll(r);
+        out = PutEscape(out + i, static_cast<unsigned char>(p[i]));
+        p += i + 1;
+    }
+    return out;
+}
+#endif // RAPIDJSON_DISPATCH
+
+//! Write [p, end) escaped as the content of a JSON string in UTF-8.
+/*! Characters other than '"', '\\' and control characters are copied, i.e. no
+    encoding validation. \c out must have room for 6 * (end - p) characters.
+    \return The end of the written characters.
+*/
+inline char* WriteEscaped(char* out, const char* p, const char* end) {
+#ifdef RAPIDJSON_DISPATCH
+    switch (GetCpuLevel()) {
+    case kCpuAVX512: return WriteEscapedAVX512(out, p, end);
+    case kCpuAVX2:   return WriteEscapedAVX2(out, p, end);
+    case kCpuSSE42:
+    case kCpuSSE2:   return WriteEscapedSSE2(out, p, end);
+    default: break;
+    }
+#endif
+    return WriteEscapedScalar(out, p, end);
+}
+
+} // namespace internal
+
 #if defined(RAPIDJSON_SSE2) || defined(RAPIDJSON_SSE42)
 template<>
 inline bool Writer<StringBuffer>::ScanWriteUnescapedString(StringStream& is, size_t length) {
@@ -698,7 +848,24 @@ inline bool Writer<StringBuffer>::ScanWriteUnescapedString(StringStream& is, siz
     is.src_ = p;
     return RAPIDJSON_LIKELY(is.Tell() < length);
 }
-#endif // RAPIDJSON_NEON
+#elif defined(RAPIDJSON_DISPATCH)
+//! Escape the whole string in one pass with the kernel selected at run time.
+template<>
+inline bool Writer<StringBuffer>::ScanWriteUnescapedString(StringStream& is, size_t length) {
+    if ((kWriteDefaultFlags & kWriteValidateEncodingFlag) || !RAPIDJSON_LIKELY(is.Tell() < length))
+        return RAPIDJSON_LIKELY(is.Tell() < length);
+
+    // WriteString() has reserved 6 bytes for every remaining character
+    const char* p = is.src_;
+    const char* end = is.head_ + length;
+    const size_t reserved = static_cast<size_t>(end - p) * 6;
+    char* out = os_->PushUnsafe(reserved);
+    os_->Pop(reserved - static_cast<size_t>(internal::WriteEscaped(out, p, end) - out));
+
+    is.src_ = end;
+    return false;
+}
+#endif // RAPIDJSON_DISPATCH
 
 RAPIDJSON_NAMESPACE_END
 
@@ -895,6 +895,42 @@ TEST(Reader, ParseString_NonDestructive) {
     EXPECT_EQ(11u, h.length_);
 }
 
+#ifdef RAPIDJSON_DISPATCH
+// Kernels that stop at every multibyte character must not rescan the rest of the
+// string each time, which took seconds for a few ten thousand CJK characters.
+TEST(Reader, ParseString_ValidateLongMultibyte) {
+    std::string run;
+    for (int i = 0; i < 100000; i++)
+        run += "\xE4\xB8\xAD"; // U+4E2D
+    const std::string json = "\"" + run + "\\n" + run + "\"";
+    const std::string expected = run + "\n" + run;
+
+    for (int level = internal::kCpuScalar; level <= internal::kCpuAVX512; level++) {
+        internal::SetCpuLevel(static_cast<internal::CpuLevel>(level));
+        {
+            StringStream s(json.c_str());
+            ParseStringHandler<UTF8<> > h;
+            Reader reader;
+            reader.Parse<kParseValidateEncodingFlag>(s, h);
+            EXPECT_FALSE(reader.HasParseError()) << "level " << level;
+            EXPECT_EQ(expected.size(), h.length_);
+            EXPECT_EQ(0, StrCmp(expected.c_str(), h.str_));
+        }
+        {
+            std::string buffer = json;
+            InsituStringStream s(&buffer[0]);
+            ParseStringHandler<UTF8<> > h;
+            Reader reader;
+            reader.Parse<kParseInsituFlag | kParseValidateEncodingFlag>(s, h);
+            EXPECT_FALSE(reader.HasParseError()) << "level " << level;
+            EXPECT_EQ(expected.size(), h.length_);
+            EXPECT_EQ(0, StrCmp(expected.c_str(), h.str_));
+        }
+    }
+    internal::SetCpuLevel(internal::kCpuAVX512);
+}
+#endif
+
 template <typename Encoding>
 ParseErrorCode TestString(const typename Encoding::Ch* str) {
     GenericStringStream<Encoding> s(str);
@@ -9,11 +9,13 @@
 
 #include <cassert>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <vector>
 #include <map>
 #include <unordered_map>
 #include <optional>
+#include <memory_resource>
 #include <type_traits>
 
 #ifndef BACKEND_RAPIDJSON
@@ -40,29 +42,108 @@ namespace static_json {
 		template<typename T>
 		static constexpr bool is_std_optional_v = is_std_optional<T>::value;
 
+		// std::string 以及 std::pmr::string 等使用其它分配器的字符串.
+		template<typename T>
+		struct is_string : public std::false_type {};
+		template<typename Traits, typename Alloc>
+		struct is_string<std::basic_string<char, Traits, Alloc>> : public std::true_type {};
+		template<typename T>
+		static constexpr bool is_string_v = is_string<std::decay_t<T>>::value;
+
 		template<typename T, typename U = void, typename V = void>
 		struct is_mapping : public std::false_type {};
 		template<typename T>
-		struct is_mapping<T, std::enable_if_t<std::is_same_v<std::string,
-			std::decay_t<typename T::key_type>>>, std::void_t<typename T::mapped_type>>
+		struct is_mapping<T, std::enable_if_t<is_string_v<typename T::key_type>>,
+			std::void_t<typename T::mapped_type>>
 			: public std::true_type {};
 		template<typename T>
 		static constexpr bool is_mapping_v = is_mapping<T>::value;
 
+		// 可按下标原地访问并可resize的序列容器, 如std::vector和std::deque.
+		template<typename T, typename U = void>
+		struct is_resizable_random_access : public std::false_type {};
+		template<typename T>
+		struct is_resizable_random_access<T, std::void_t<decltype(std::declval<T&>().resize(0)),
+			decltype(std::declval<T&>()[0])>>
+			: public std::true_type {};
+		template<typename T>
+		static constexpr bool is_resizable_random_access_v = is_resizable_random_access<T>::value;
+
+		// 用memory_resource构造T, T不使用分配器时忽略resource.
+		template<typename T, typename... Args>
+		T make_with_resource(std::pmr::memory_resource* resource, Args&&... args)
+		{
+			using alloc_type = std::pmr::polymorphic_allocator<char>;
+			if constexpr (std::uses_allocator_v<T, alloc_type> &&
+				std::is_constructible_v<T, Args..., alloc_type>)
+			{
+				if (resource)
+					return T(std::forward<Args>(args)..., alloc_type(resource));
+			}
+			return T(std::forward<Args>(args)...);
+		}
+
+		// get_allocator()返回std::pmr::polymorphic_allocator的类型, 如std::pmr容器.
+		template<typename T, typename U = void>
+		struct has_polymorphic_allocator : public std::false_type {};
+		template<typename T>
+		struct has_polymorphic_allocator<T, std::enable_if_t<std::is_convertible_v<
+			decltype(std::declval<const T&>().get_allocator()), std::pmr::polymorphic_allocator<char>>>>
+			: public std::true_type {};
+
+		// value所用的memory_resource, T没有polymorphic_allocator时返回fallback.
+		template<typename T>
+		std::pmr::memory_resource* resource_of(const T& value, std::pmr::memory_resource* fallback)
+		{
+			if constexpr (has_polymorphic_allocator<T>::value)
+				return value.get_allocator().resource();
+			else
+				return fallback;
+		}
+
+		// 不持有内存, 指向json缓冲区的字符串(in-situ解析).
+		template<typename T>
+		static constexpr bool is_string_ref_v = std::is_same_v<std::decay_t<T>, std::string_view>
+			|| std::is_same_v<std::decay_t<T>, const char*>;
+
 	} // namespace traits
 
+	// 反序列化到已有对象时的方式.
+	enum class load_mode
+	{
+		// 数组元素追加到容器末尾, optional和映射中的值重新构造.
+		append,
+		// 原地覆盖已有的元素, 数组按json中的长度截断, 复用string/vector等已有的容量,
+		// 用于反复解码到同一个对象. 映射中json没有的key被删除, null清空optional,
+		// json中不存在的字段保持不变.
+		update,
+	};
+
 	template<class T>
 	struct nvp :
 		public std::pair<const char *, T *>
 	{
-		explicit nvp(const char * name_, T & t) :
-			std::pair<const char *, T *>(name_, std::addressof(t))
+		explicit nvp(const char * name_, T & t,
+			const char * quoted_ = nullptr, std::size_t quoted_length_ = 0) :
+			std::pair<const char *, T *>(name_, std::addressof(t)),
+			quoted(quoted_),
+			quoted_length(quoted_length_)
 		{}
 
 		const char* name() const {
 			return this->first;
 		}
 
+		// 编译期生成的带引号key, 例如 "\"name\"", 输出时无需再转义.
+		// 使用自定义key的宏时为空.
+		const char* quoted_name() const {
+			return quoted;
+		}
+
+		std::size_t quoted_name_length() const {
+			return quoted_length;
+		}
+
 		T & value() const {
 			return *(this->second);
 		}
@@ -70,6 +151,9 @@ namespace static_json {
 		const T & const_value() const {
 			return *(this->second);
 		}
+
+		const char * quoted;
+		std::size_t quoted_length;
 	};
 
 	template<class T>
@@ -77,6 +161,11 @@ namespace static_json {
 		return nvp< T >(name, t);
 	}
 
+	template<class T, std::size_t N>
+	inline const nvp< T > make_nvp(const char * name, T & t, const char (&quoted)[N]) {
+		return nvp< T >(name, t, quoted, N - 1);
+	}
+
 	struct access {
 		template<class B, class D>
 		using base_cast = std::conditional<std::is_const_v<D>, const B, B>;
@@ -119,15 +208,20 @@ namespace static_json {
 #define JSON_PP_STRINGIZE(text) JSON_PP_STRINGIZE_I(text)
 #define JSON_PP_STRINGIZE_I(...) #__VA_ARGS__
 
+// 成员名是合法的标识符, 无需转义, 直接在编译期加上引号.
+#define JSON_PP_QUOTE(text) "\"" JSON_PP_STRINGIZE(text) "\""
+
 
 // 用于serialize成员函数中声明要序列化的成员.
 #define JSON_SERIALIZATION_NVP(name)	\
-    static_json::make_nvp(JSON_PP_STRINGIZE(name), name)
+    static_json::make_nvp(JSON_PP_STRINGIZE(name), name, JSON_PP_QUOTE(name))
 
 #define JSON_SERIALIZATION_BASE_OBJECT_NVP(name) \
-	static_json::make_nvp(JSON_PP_STRINGIZE(name), base_object<name>(*this))
+	static_json::make_nvp(JSON_PP_STRINGIZE(name), base_object<name>(*this), JSON_PP_QUOTE(name))
 
 // 侵入式, 指定key.
+// key可以是运行时的字符串, 但from_json_string解码该对象期间须保持有效, 不能是serialize中的临时变量.
+// 同一对象中key重复时, from_json_string只填充第一个字段, from_json填充全部.
 #define JSON_SERIALIZATION_KEY_NVP(key, name)	\
     static_json::make_nvp(key, name)
 
@@ -137,11 +231,11 @@ namespace static_json {
 
 // 非侵入式，避免类成员名字生成不正确.
 #define JSON_NI_SERIALIZATION_NVP(classname, name)	\
-    static_json::make_nvp(JSON_PP_STRINGIZE(name), classname . name)
+    static_json::make_nvp(JSON_PP_STRINGIZE(name), classname . name, JSON_PP_QUOTE(name))
 
 // 非侵入式, 指定基类.
 #define JSON_NI_SERIALIZATION_BASE_OBJECT_NVP(classname, name)	\
-    static_json::make_nvp(JSON_PP_STRINGIZE(name), base_object<classname>(*this))
+    static_json::make_nvp(JSON_PP_STRINGIZE(name), base_object<classname>(*this), JSON_PP_QUOTE(name))
 
 // 非侵入式, 指定key.
 #define JSON_NI_SERIALIZATION_KEY_NVP(key, classname, name)	\
@@ -159,45 +253,479 @@ namespace static_json {
 
 namespace static_json {
 	template<class T>
-	void to_json(const T& a, rapidjson::Value& json)
+	void to_json(const T& a, rapidjson::Value& json, rapidjson::Value::AllocatorType& alloc)
 	{
-		archive::rapidjson_oarchive ja(json);
+		archive::rapidjson_oarchive ja(json, alloc);
 		ja << a;
 	}
 
+	// 使用doc的内存池, 重复使用doc时可先SetNull()再GetAllocator().Clear()释放上次的节点.
 	template<class T>
-	void from_json(T& a, const rapidjson::Value& json)
+	void to_json(const T& a, rapidjson::Document& doc)
 	{
-		archive::rapidjson_iarchive ja(json);
+		to_json(a, doc, doc.GetAllocator());
+	}
+
+	// resource不为空时, 解码过程中新建的optional值和映射的key等从resource分配,
+	// 容器中的元素由容器自身的polymorphic_allocator构造.
+	template<class T>
+	void from_json(T& a, const rapidjson::Value& json, load_mode mode = load_mode::append,
+		std::pmr::memory_resource* resource = nullptr)
+	{
+		archive::rapidjson_iarchive ja(json, mode, resource);
 		ja >> a;
 	}
 
+	// 按str的长度解析, str无需以'\0'结尾, 可直接传入接收缓冲区或mmap的内存.
+	// parseFlags 如 rapidjson::kParseValidateEncodingFlag, 校验字符串为合法UTF-8(SIMD).
+	template<unsigned parseFlags, class T>
+	bool from_json_string(T& a, std::string_view str, load_mode mode = load_mode::append,
+		std::pmr::memory_resource* resource = nullptr)
+	{
+		rapidjson::Reader reader;
+		rapidjson::MemoryStream is(str.data(), str.size());
+		archive::rapidjson_sax_iarchive ja(a, mode, resource);
+		return !reader.Parse<parseFlags>(is, ja).IsError();
+	}
+
+	template<class T>
+	bool from_json_string(T& a, std::string_view str, load_mode mode = load_mode::append,
+		std::pmr::memory_resource* resource = nullptr)
+	{
+		return from_json_string<rapidjson::kParseDefaultFlags>(a, str, mode, resource);
+	}
+
+	// 直接输出到rapidjson::Writer或PrettyWriter, 不构建DOM.
+	template<class T, class Writer,
+		std::enable_if_t<!std::is_convertible_v<Writer&, rapidjson::Value&>, int> = 0>
+	void to_json(const T& a, Writer& writer)
+	{
+		archive::rapidjson_writer_oarchive<Writer> ja(writer);
+		ja << a;
+	}
+
+	// 序列化结果追加到str中, 可重复使用str的容量.
 	template<class T>
-	bool from_json_string(T& a, std::string_view str)
+	void to_json_string(const T& a, std::string& str)
 	{
-		rapidjson::Document doc;
-		if (doc.Parse(str.data()).HasParseError())
-			return false;
+		archive::string_output_stream os(str);
+		archive::json_writer<archive::string_output_stream> writer(os);
+		to_json(a, writer);
+	}
 
-		rapidjson::Value v;
-		doc.Swap(v);
+	// in-situ解析, 字符串直接在str中解码, 不再复制.
+	// std::string_view 和 const char* 成员指向str, str需在使用期间保持有效.
+	template<unsigned parseFlags, class T>
+	bool from_json_insitu(T& a, char* str, load_mode mode = load_mode::append,
+		std::pmr::memory_resource* resource = nullptr)
+	{
+		rapidjson::Reader reader;
+		rapidjson::InsituStringStream is(str);
+		archive::rapidjson_sax_iarchive ja(a, mode, resource);
+		return !reader.Parse<parseFlags | rapidjson::kParseInsituFlag>(is, ja).IsError();
+	}
 
-		from_json(a, v);
-		return true;
+	template<class T>
+	bool from_json_insitu(T& a, char* str, load_mode mode = load_mode::append,
+		std::pmr::memory_resource* resource = nullptr)
+	{
+		return from_json_insitu<rapidjson::kParseDefaultFlags>(a, str, mode, resource);
 	}
 
 	template<class T>
 	std::string to_json_string(const T& a)
 	{
-		rapidjson::Value v{ rapidjson::kObjectType };
-		to_json(a, v);
+		std::string str;
+		to_json_string(a, str);
+		return str;
+	}
+
+	// 可重复使用的解析上下文, 保留Reader的栈和SAX帧的缓冲区,
+	// 每次解析只清空而不释放, 高频调用时省去这些内存的分配和释放.
+	// 不可重入, 也不可在线程间共享, 每个线程一个, 或使用thread_parse_context().
+	class parse_context
+	{
+	public:
+		template<unsigned parseFlags, class T>
+		bool parse(T& a, std::string_view str, load_mode mode, std::pmr::memory_resource* resource)
+		{
+			rapidjson::MemoryStream is(str.data(), str.size());
+			archive_.reset(a, mode, resource);
+			result_ = reader_.template Parse<parseFlags>(is, archive_);
+			return !result_.IsError();
+		}
 
-		rapidjson::StringBuffer buffer;
-		rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-		v.Accept(writer);
+		const rapidjson::ParseResult& error() const
+		{
+			return result_;
+		}
+
+	private:
+		rapidjson::Reader reader_;
+		archive::rapidjson_sax_iarchive archive_;
+		rapidjson::ParseResult result_;
+	};
 
-		return buffer.GetString();
+	// 当前线程的解析上下文.
+	inline parse_context& thread_parse_context()
+	{
+		thread_local parse_context context;
+		return context;
+	}
+
+	template<unsigned parseFlags, class T>
+	bool from_json_string(T& a, std::string_view str, parse_context& context,
+		load_mode mode = load_mode::append, std::pmr::memory_resource* resource = nullptr)
+	{
+		return context.template parse<parseFlags>(a, str, mode, resource);
 	}
+
+	template<class T>
+	bool from_json_string(T& a, std::string_view str, parse_context& context,
+		load_mode mode = load_mode::append, std::pmr::memory_resource* resource = nullptr)
+	{
+		return context.template parse<rapidjson::kParseDefaultFlags>(a, str, mode, resource);
+	}
+
+	// 逐条读取NDJSON(JSON Lines), 每次解码一条记录到调用者复用的T中.
+	// InputStream为rapidjson的输入流, 如 FileReadStream, IStreamWrapper, MemoryStream,
+	// 整个输入只需缓冲区大小的内存.
+	// 默认每条记录解码前先重置为空的T, std::pmr类型保留记录原来的memory_resource;
+	// 使用load_mode::update时复用上一条记录的容量,
+	// 但本条json中没有的字段会保留上一条的值.
+	template<class T, class InputStream>
+	class json_lines_reader
+	{
+	public:
+		explicit json_lines_reader(InputStream& is, load_mode mode = load_mode::append,
+			std::pmr::memory_resource* resource = nullptr)
+			: is_(is)
+			, mode_(mode)
+			, resource_(resource)
+			, archive_(mode, resource)
+		{}
+
+		// 读取下一条记录, 输入结束或出错时返回false, 用error()区分.
+		bool read(T& record)
+		{
+			rapidjson::SkipWhitespace(is_);
+			if (is_.Peek() == '\0')
+				return false;
+
+			if (mode_ == load_mode::append)
+				record = traits::make_with_resource<T>(traits::resource_of(record, resource_));
+			archive_.reset(record);
+			result_ = reader_.template Parse<rapidjson::kParseStopWhenDoneFlag>(is_, archive_);
+			return !result_.IsError();
+		}
+
+		const rapidjson::ParseResult& error() const
+		{
+			return result_;
+		}
+
+	private:
+		InputStream& is_;
+		load_mode mode_;
+		std::pmr::memory_resource* resource_;
+		rapidjson::Reader reader_;
+		archive::rapidjson_sax_iarchive archive_;
+		rapidjson::ParseResult result_;
+	};
+
+	// 以NDJSON格式将记录逐条追加到同一个字符串中, 每条记录以'\n'结束.
+	class json_lines_writer
+	{
+	public:
+		explicit json_lines_writer(std::string& str)
+			: os_(str)
+			, writer_(os_)
+		{}
+
+		template<class T>
+		void write(const T& record)
+		{
+			writer_.Reset(os_);
+			to_json(record, writer_);
+			os_.Put('\n');
+		}
+
+	private:
+		archive::string_output_stream os_;
+		archive::json_writer<archive::string_output_stream> writer_;
+	};
+
+	// json_push_parser::feed 和 finish 的结果.
+	enum class parse_status {
+		need_more,	// 收到的数据已全部解码, 等待下一块.
+		done,		// 根值已解码完成; 不使用kParseStopWhenDoneFlag时只由finish()返回.
+		error,		// 解析失败, 见error().
+	};
+
+	// 推送式增量解析, 数据分块到达时(如从socket)边收边解码到T, 不必先缓存整个请求体.
+	// 由GenericReader::IterativeParseNext逐个token驱动. 每次只交给reader以完整值结束的
+	// 一段输入, 块末尾不完整的token(截断的字符串, 数字等)留待下一块到达后再解析,
+	// 因此只需缓存这一小段.
+	// 输入结束时调用finish(), 根值为数字时只有到这里才能确定它已完整; 不使用
+	// kParseStopWhenDoneFlag时也只有finish()才能确认根值之后只有空白, 所以应把所有块都
+	// 交给feed(), feed()在根值结束后仍返回need_more, 直到finish()返回done.
+	template<unsigned parseFlags = rapidjson::kParseDefaultFlags>
+	class json_push_parser
+	{
+		static_assert(!(parseFlags & rapidjson::kParseInsituFlag), "in-situ parsing needs the whole document");
+		static_assert(!(parseFlags & rapidjson::kParseCommentsFlag), "comments are not supported");
+
+	public:
+		// 使用前先reset.
+		json_push_parser() = default;
+
+		template<class T>
+		explicit json_push_parser(T& a, load_mode mode = load_mode::append,
+			std::pmr::memory_resource* resource = nullptr)
+		{
+			reset(a, mode, resource);
+		}
+
+		// 开始解码下一个json到a, 保留内部缓冲区的容量.
+		template<class T>
+		void reset(T& a, load_mode mode = load_mode::append,
+			std::pmr::memory_resource* resource = nullptr)
+		{
+			// 上次未解析完时reader的状态栈不为空, 在空输入上走一步让reader清空它.
+			if (!complete_)
+			{
+				rapidjson::MemoryStream empty(nullptr, 0);
+				reader_.template IterativeParseNext<parseFlags>(empty, archive_);
+			}
+
+			reader_.IterativeParseInit();
+			archive_.reset(a, mode, resource);
+			result_.Clear();
+			pending_.clear();
+			scan_ = scan_state();
+			offset_ = 0;
+			complete_ = false;
+			status_ = parse_status::need_more;
+		}
+
+		// 解码新到达的一块数据, chunk在返回后即可释放.
+		parse_status feed(std::string_view chunk)
+		{
+			if (complete_)
+				return trailing(chunk);
+			if (status_ == parse_status::error)
+				return status_;
+
+			if (!pending_.empty())
+			{
+				// 先补全上一块末尾的token.
+				auto n = scan(chunk, true);
+				if (n == std::string_view::npos)
+				{
+					pending_.append(chunk.data(), chunk.size());
+					return status_;
+				}
+
+				pending_.append(chunk.data(), n);
+				parse(pending_.data(), pending_.size());
+				pending_.clear();
+				chunk.remove_prefix(n);
+				if (complete_)
+					return trailing(chunk);
+				if (status_ == parse_status::error)
+					return status_;
+			}
+
+			// 其余部分直接在chunk上解析, 只复制末尾不完整的token.
+			auto n = scan(chunk, false);
+			if (n == std::string_view::npos)
+				n = 0;
+
+			parse(chunk.data(), n);
+			chunk.remove_prefix(n);
+			if (complete_)
+				return trailing(chunk);
+			if (status_ == parse_status::need_more)
+				pending_.assign(chunk.data(), chunk.size());
+			return status_;
+		}
+
+		// 输入结束. 根值仍不完整时返回error.
+		parse_status finish()
+		{
+			if (status_ != parse_status::need_more)
+				return status_;
+			if (complete_)
+			{
+				status_ = parse_status::done;
+				return status_;
+			}
+
+			// 先跳过空白, 只剩空白时由reader按当前状态报告缺少的内容.
+			rapidjson::MemoryStream is(pending_.data(), pending_.size());
+			rapidjson::SkipWhitespace(is);
+			while (!reader_.IterativeParseComplete())
+			{
+				if (!reader_.template IterativeParseNext<parseFlags>(is, archive_))
+					return fail();
+			}
+
+			offset_ += is.Tell();
+			pending_.clear();
+			complete_ = true;
+			status_ = parse_status::done;
+			return status_;
+		}
+
+		parse_status status() const
+		{
+			return status_;
+		}
+
+		// 错误的偏移是相对于整个输入的.
+		const rapidjson::ParseResult& error() const
+		{
+			return result_;
+		}
+
+		// 已解析的输入字节数. 使用kParseStopWhenDoneFlag时, done之后即为根值结束的位置,
+		// 其后的数据(如同一连接上的下一个请求)未被读取.
+		std::size_t offset() const
+		{
+			return offset_;
+		}
+
+	private:
+		struct scan_state
+		{
+			bool in_string = false;
+			bool escape = false;
+			bool scalar = false;
+		};
+
+		// 找到s中最后一个(first为true时第一个)完整值token之后的位置, 没有时返回npos.
+		// ',' 和 ':' 不能作为结尾, reader读完它们会接着读下一个token.
+		// 数字和true/false/null要遇到其后的分隔符才算完整, 位置取在分隔符之前.
+		std::size_t scan(std::string_view s, bool first)
+		{
+			auto safe = std::string_view::npos;
+			for (std::size_t i = 0; i < s.size(); i++)
+			{
+				auto c = s[i];
+				if (scan_.in_string)
+				{
+					if (scan_.escape)
+					{
+						scan_.escape = false;
+						continue;
+					}
+
+					while (c != '"' && c != '\\' && ++i < s.size())
+						c = s[i];
+					if (i == s.size())
+						break;
+
+					if (c == '\\')
+					{
+						scan_.escape = true;
+					}
+					else
+					{
+						scan_.in_string = false;
+						safe = i + 1;
+						if (first)
+							return safe;
+					}
+					continue;
+				}
+
+				switch (c)
+				{
+				case ' ': case '\t': case '\n': case '\r': case ',': case ':':
+				case '"': case '{': case '}': case '[': case ']':
+					if (scan_.scalar)
+					{
+						scan_.scalar = false;
+						safe = i;
+						if (first)
+							return safe;
+					}
+					if (c == '"')
+					{
+						scan_.in_string = true;
+					}
+					else if (c == '{' || c == '}' || c == '[' || c == ']')
+					{
+						safe = i + 1;
+						if (first)
+							return safe;
+					}
+					break;
+				default:
+					scan_.scalar = true;
+					break;
+				}
+			}
+			return safe;
+		}
+
+		void parse(const char* str, std::size_t length)
+		{
+			rapidjson::MemoryStream is(str, length);
+			while (is.Tell() < length)
+			{
+				if (!reader_.template IterativeParseNext<parseFlags>(is, archive_))
+				{
+					fail();
+					return;
+				}
+				if (reader_.IterativeParseComplete())
+				{
+					complete_ = true;
+					if (parseFlags & rapidjson::kParseStopWhenDoneFlag)
+						status_ = parse_status::done;
+					break;
+				}
+			}
+			offset_ += is.Tell();
+		}
+
+		// 根值之后只允许空白, 除非使用kParseStopWhenDoneFlag.
+		parse_status trailing(std::string_view chunk)
+		{
+			if (parseFlags & rapidjson::kParseStopWhenDoneFlag)
+				return status_;
+
+			for (std::size_t i = 0; i < chunk.size(); i++)
+			{
+				auto c = chunk[i];
+				if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+				{
+					result_.Set(rapidjson::kParseErrorDocumentRootNotSingular, offset_ + i);
+					status_ = parse_status::error;
+					return status_;
+				}
+			}
+			offset_ += chunk.size();
+			return status_;
+		}
+
+		parse_status fail()
+		{
+			result_.Set(reader_.GetParseErrorCode(), offset_ + reader_.GetErrorOffset());
+			status_ = parse_status::error;
+			return status_;
+		}
+
+		rapidjson::Reader reader_;
+		archive::rapidjson_sax_iarchive archive_;
+		rapidjson::ParseResult result_;
+		std::string pending_;
+		scan_state scan_;
+		std::size_t offset_ = 0;
+		bool complete_ = false;
+		parse_status status_ = parse_status::need_more;
+	};
 }
 #endif
 
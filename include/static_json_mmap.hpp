@@ -0,0 +1,346 @@
+﻿//
+// Copyright (C) 2019 Jack.
+//
+// Author: jack
+// Email:  jack.wgm at gmail dot com
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <new>
+#include <memory>
+#include <memory_resource>
+#include <filesystem>
+
+#include "static_json.hpp"
+#include "rapidjson/filewritestream.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace static_json {
+
+	namespace detail {
+
+		constexpr std::size_t huge_page_size = 2 * 1024 * 1024;
+
+		inline std::size_t round_up(std::size_t n, std::size_t align)
+		{
+			return (n + align - 1) / align * align;
+		}
+
+		// 保留size字节的匿名内存, 页面在首次写入时才提交. 失败返回nullptr.
+		inline void* map_region(std::size_t size, bool huge_pages)
+		{
+#if defined(_WIN32)
+			if (huge_pages)
+			{
+				// 需要SeLockMemoryPrivilege, 没有时退回普通页.
+				auto large = GetLargePageMinimum();
+				if (large && size % large == 0)
+				{
+					if (auto p = VirtualAlloc(nullptr, size,
+						MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE))
+						return p;
+				}
+			}
+			return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+			int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_HUGETLB)
+			// 预留的hugetlbfs大页, 通常需要管理员配置, 没有时退回透明大页.
+			// 不能加MAP_NORESERVE, 否则大页不足时mmap仍成功, 写入时才SIGBUS.
+			if (huge_pages)
+			{
+				auto p = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+				if (p != MAP_FAILED)
+					return p;
+			}
+#endif
+#if defined(MAP_NORESERVE)
+			flags |= MAP_NORESERVE;
+#endif
+			// 多保留一个大页, 截去首尾使起始地址按大页对齐, 透明大页才能完整覆盖.
+			auto reserve = huge_pages ? size + huge_page_size : size;
+			auto p = mmap(nullptr, reserve, PROT_READ | PROT_WRITE, flags, -1, 0);
+			if (p == MAP_FAILED)
+				return nullptr;
+			if (!huge_pages)
+				return p;
+
+			auto base = reinterpret_cast<std::uintptr_t>(p);
+			auto aligned = round_up(base, huge_page_size);
+			if (aligned != base)
+				munmap(p, aligned - base);
+			if (auto tail = base + reserve - (aligned + size))
+				munmap(reinterpret_cast<void*>(aligned + size), tail);
+			p = reinterpret_cast<void*>(aligned);
+#if defined(MADV_HUGEPAGE)
+			madvise(p, size, MADV_HUGEPAGE);
+#endif
+			return p;
+#endif
+		}
+
+		inline void unmap_region(void* p, std::size_t size)
+		{
+#if defined(_WIN32)
+			(void)size;
+			VirtualFree(p, 0, MEM_RELEASE);
+#else
+			munmap(p, size);
+#endif
+		}
+
+		// 须在内存池析构之后才释放映射.
+		struct mapped_region
+		{
+			void* data;
+			std::size_t size;
+			bool owned;
+
+			~mapped_region()
+			{
+				if (owned)
+					unmap_region(data, size);
+			}
+		};
+
+		// 只读映射整个文件, 页面按需从page cache读入, 不复制到用户缓冲区.
+		class mapped_file
+		{
+		public:
+			explicit mapped_file(const std::filesystem::path& path)
+			{
+#if defined(_WIN32)
+				auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+					OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+				if (file == INVALID_HANDLE_VALUE)
+					return;
+				LARGE_INTEGER size;
+				if (GetFileSizeEx(file, &size))
+				{
+					if (size.QuadPart == 0)
+					{
+						data_ = "";
+					}
+					else if (auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr))
+					{
+						data_ = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+						if (data_)
+							size_ = static_cast<std::size_t>(size.QuadPart);
+						CloseHandle(mapping);
+					}
+				}
+				CloseHandle(file);
+#else
+				auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+				if (fd < 0)
+					return;
+				struct stat st;
+				if (fstat(fd, &st) == 0)
+				{
+					if (st.st_size == 0)
+					{
+						// 空文件无法mmap, 交给解析器报告空文档错误.
+						data_ = "";
+					}
+					else
+					{
+						auto p = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+						if (p != MAP_FAILED)
+						{
+							data_ = static_cast<const char*>(p);
+							size_ = static_cast<std::size_t>(st.st_size);
+#if defined(MADV_SEQUENTIAL)
+							madvise(p, size_, MADV_SEQUENTIAL);
+#endif
+						}
+					}
+				}
+				close(fd);
+#endif
+			}
+
+			~mapped_file()
+			{
+				if (!size_)
+					return;
+#if defined(_WIN32)
+				UnmapViewOfFile(data_);
+#else
+				munmap(const_cast<char*>(data_), size_);
+#endif
+			}
+
+			mapped_file(const mapped_file&) = delete;
+			mapped_file& operator=(const mapped_file&) = delete;
+
+			bool is_open() const
+			{
+				return data_ != nullptr;
+			}
+
+			std::string_view view() const
+			{
+				return { data_, size_ };
+			}
+
+		private:
+			const char* data_ = nullptr;
+			std::size_t size_ = 0;
+		};
+
+		struct file_closer
+		{
+			void operator()(std::FILE* fp) const
+			{
+				std::fclose(fp);
+			}
+		};
+	}
+
+	// 预先保留的一整块虚拟内存, 可选大页, 用于解析数百MB的json时减少TLB缺失和
+	// 逐个64KB chunk的malloc.
+	// allocator()以整块内存作为rapidjson::MemoryPoolAllocator的首个chunk, 可直接交给
+	// rapidjson::Document; region本身也是std::pmr::memory_resource, 可作为from_json
+	// 等接口的resource参数. 两者从同一块内存顺序分配, 用满后MemoryPoolAllocator
+	// 会按2MB向malloc申请新chunk, 这些chunk不在region内, 也不保证是大页, 可用
+	// spilled()检查; 需要全程大页时应按json大小留足余量.
+	// 也可以传入调用者自己的内存(如静态数组或共享内存), region不负责释放.
+	// clear()后重新从头分配, 已提交的页面保留, 不归还系统. 不是线程安全的.
+	class memory_region : public std::pmr::memory_resource
+	{
+	public:
+		explicit memory_region(std::size_t size, bool huge_pages = true)
+			: region_{ map(detail::round_up(size, detail::huge_page_size), huge_pages),
+				detail::round_up(size, detail::huge_page_size), true }
+			, pool_(region_.data, region_.size, detail::huge_page_size)
+		{}
+
+		// buffer至少8字节对齐, 生命期长于region.
+		memory_region(void* buffer, std::size_t size)
+			: region_{ buffer, size, false }
+			, pool_(region_.data, region_.size, detail::huge_page_size)
+		{}
+
+
+		memory_region(const memory_region&) = delete;
+		memory_region& operator=(const memory_region&) = delete;
+
+		// 如 rapidjson::Document doc(&region.allocator());
+		rapidjson::MemoryPoolAllocator<>& allocator()
+		{
+			return pool_;
+		}
+
+		// 之前分配的内存全部失效.
+		void clear()
+		{
+			pool_.Clear();
+		}
+
+		// 预留的region大小, 不含溢出的chunk.
+		std::size_t capacity() const
+		{
+			return region_.size;
+		}
+
+		// 已分配的字节数, 含溢出到malloc的chunk.
+		std::size_t used() const
+		{
+			return pool_.Size();
+		}
+
+		// region已用满, 有chunk来自malloc. region自身作为首个chunk时扣除了chunk头,
+		// 总容量超过region_.size说明还有其它chunk. clear()后复位.
+		bool spilled() const
+		{
+			return pool_.Capacity() > region_.size;
+		}
+
+	private:
+		static void* map(std::size_t size, bool huge_pages)
+		{
+			auto p = detail::map_region(size, huge_pages);
+			if (!p)
+				throw std::bad_alloc();
+			return p;
+		}
+
+		void* do_allocate(std::size_t bytes, std::size_t alignment) override
+		{
+			// MemoryPoolAllocator只保证8字节对齐.
+			auto n = bytes + (alignment > 8 ? alignment - 8 : 0);
+			auto p = pool_.Malloc(n ? n : 1);
+			if (!p)
+				throw std::bad_alloc();
+			auto addr = detail::round_up(reinterpret_cast<std::uintptr_t>(p), alignment);
+			return reinterpret_cast<void*>(addr);
+		}
+
+		void do_deallocate(void*, std::size_t, std::size_t) override
+		{}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+
+		detail::mapped_region region_;
+		rapidjson::MemoryPoolAllocator<> pool_;
+	};
+
+	// 映射文件后按长度直接解析, 不先读入std::string. 文件不存在或解析失败返回false.
+	// 与from_json_string相同, 字符串都会复制, 解码结果不引用映射的内存.
+	template<unsigned parseFlags, class T>
+	bool from_json_file(T& a, const std::filesystem::path& path, load_mode mode = load_mode::append,
+		std::pmr::memory_resource* resource = nullptr)
+	{
+		detail::mapped_file file(path);
+		if (!file.is_open())
+			return false;
+		return from_json_string<parseFlags>(a, file.view(), mode, resource);
+	}
+
+	template<class T>
+	bool from_json_file(T& a, const std::filesystem::path& path, load_mode mode = load_mode::append,
+		std::pmr::memory_resource* resource = nullptr)
+	{
+		return from_json_file<rapidjson::kParseDefaultFlags>(a, path, mode, resource);
+	}
+
+	// 经buffer_size字节的缓冲直接写入文件, 不在内存中生成完整的字符串.
+	// 打开, 写入或关闭失败时返回false.
+	template<class T>
+	bool to_json_file(const T& a, const std::filesystem::path& path,
+		std::size_t buffer_size = 1024 * 1024)
+	{
+#if defined(_WIN32)
+		std::unique_ptr<std::FILE, detail::file_closer> fp(_wfopen(path.c_str(), L"wb"));
+#else
+		std::unique_ptr<std::FILE, detail::file_closer> fp(std::fopen(path.c_str(), "wb"));
+#endif
+		if (!fp)
+			return false;
+
+		std::unique_ptr<char[]> buffer(new char[buffer_size]);
+		rapidjson::FileWriteStream os(fp.get(), buffer.get(), buffer_size);
+		archive::json_writer<rapidjson::FileWriteStream> writer(os);
+		to_json(a, writer);
+		os.Flush();
+
+		if (std::ferror(fp.get()))
+			return false;
+		return std::fclose(fp.release()) == 0;
+	}
+}
@@ -0,0 +1,427 @@
+﻿//
+// Copyright (C) 2019 Jack.
+//
+// Author: jack
+// Email:  jack.wgm at gmail dot com
+//
+
+#pragma once
+
+#include <cstring>
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "static_json.hpp"
+
+namespace static_json {
+
+	struct parallel_options
+	{
+		// 工作线程数, 为0时使用std::thread::hardware_concurrency().
+		std::size_t threads = 0;
+
+		// 解码时每个任务处理的输入字节数.
+		std::size_t chunk_size = 1024 * 1024;
+
+		// 序列化时每个任务处理的元素数.
+		std::size_t chunk_elements = 4096;
+
+		// 为true时按输入顺序交付结果, 否则哪个任务先完成先交付哪个.
+		bool ordered = true;
+	};
+
+	namespace detail {
+
+		// std::vector<bool>的相邻元素共用一个字, 不能由多个线程分别写入.
+		template<class T>
+		struct is_bit_vector : public std::false_type {};
+		template<class Allocator>
+		struct is_bit_vector<std::vector<bool, Allocator>> : public std::true_type {};
+
+		inline std::size_t parallel_threads(const parallel_options& options, std::size_t tasks)
+		{
+			auto threads = options.threads;
+			if (threads == 0)
+				threads = (std::max)(std::thread::hardware_concurrency(), 1u);
+			return (std::min)(threads, tasks);
+		}
+
+		// 由工作线程执行work(i, result)完成count个任务, 在调用线程中按顺序(ordered)
+		// 或完成顺序调用deliver(i, result). 同时存在的结果最多为线程数的2倍, 内存有界.
+		// 任一work返回false时不再分派新任务, 已完成的结果照常交付, 最终返回false.
+		template <typename Result, typename Work, typename Deliver>
+		bool run_parallel(std::size_t count, std::size_t threads, bool ordered, Work&& work, Deliver&& deliver)
+		{
+			struct slot
+			{
+				enum { idle, ready, done } state = idle;
+				bool ok = true;
+				Result result;
+			};
+
+			if (count == 0)
+				return true;
+
+			const std::size_t window = threads * 2;
+			std::vector<slot> slots(window);
+			std::mutex mutex;
+			std::condition_variable cv;
+			std::size_t next = 0;	// 下一个分派的任务.
+			std::size_t low = 0;	// 最小的未交付任务.
+			std::size_t running = 0;
+			bool stop = false;
+			bool ok = true;
+			std::exception_ptr error;
+
+			auto worker = [&]()
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				for (;;)
+				{
+					cv.wait(lock, [&]() { return stop || next >= count || next < low + window; });
+					if (stop || next >= count)
+						return;
+
+					auto i = next++;
+					running++;
+					lock.unlock();
+
+					Result result;
+					bool success = false;
+					std::exception_ptr e;
+					try
+					{
+						success = work(i, result);
+					}
+					catch (...)
+					{
+						e = std::current_exception();
+					}
+
+					lock.lock();
+					auto& s = slots[i % window];
+					s.result = std::move(result);
+					s.ok = success;
+					s.state = slot::ready;
+					if (!success)
+					{
+						// 之后的任务不再分派.
+						count = (std::min)(count, i + 1);
+						if (e && !error)
+							error = e;
+					}
+					running--;
+					cv.notify_all();
+				}
+			};
+
+			std::vector<std::thread> pool;
+			for (std::size_t i = 0; i < threads; i++)
+				pool.emplace_back(worker);
+
+			try
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				while (low < count || running > 0)
+				{
+					std::size_t index = count;
+					cv.wait(lock, [&]()
+					{
+						if (ordered)
+						{
+							if (low < count && slots[low % window].state == slot::ready)
+								index = low;
+						}
+						else
+						{
+							for (auto i = low; i < next; i++)
+							{
+								if (slots[i % window].state == slot::ready)
+								{
+									index = i;
+									break;
+								}
+							}
+						}
+						return index < count || (low >= count && running == 0);
+					});
+					if (index >= count)
+						break;
+
+					auto& s = slots[index % window];
+					auto result = std::move(s.result);
+					auto success = s.ok;
+					s.state = slot::done;
+					lock.unlock();
+
+					deliver(index, std::move(result));
+
+					lock.lock();
+					if (!success)
+						ok = false;
+					while (low < next && slots[low % window].state == slot::done)
+					{
+						slots[low % window].state = slot::idle;
+						low++;
+					}
+					cv.notify_all();
+				}
+			}
+			catch (...)
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					stop = true;
+				}
+				cv.notify_all();
+				for (auto& t : pool)
+					t.join();
+				throw;
+			}
+
+			for (auto& t : pool)
+				t.join();
+
+			if (error)
+				std::rethrow_exception(error);
+			return ok;
+		}
+	}
+
+	namespace detail {
+
+		// 扫描顶层数组的元素边界, 跳过字符串和嵌套的对象/数组. bounds[k]为第k个元素之前的
+		// '['或','的位置, 最后一项为']'的位置. 只检查结构, 元素内容由各自的解析检查.
+		inline bool split_array(std::string_view str, std::vector<std::size_t>& bounds)
+		{
+			auto p = str.data();
+			auto end = p + str.size();
+			auto space = [](char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; };
+
+			while (p != end && space(*p))
+				p++;
+			if (p == end || *p != '[')
+				return false;
+
+			bounds.clear();
+			bounds.push_back(p - str.data());
+			std::size_t depth = 0;
+			for (p++; p != end; p++)
+			{
+				switch (*p)
+				{
+				case '"':
+					for (p++; p != end && *p != '"'; p++)
+					{
+						if (*p == '\\' && ++p == end)
+							return false;
+					}
+					if (p == end)
+						return false;
+					break;
+				case '[':
+				case '{':
+					depth++;
+					break;
+				case ']':
+				case '}':
+					if (depth-- > 0)
+						break;
+					if (*p != ']')
+						return false;
+					bounds.push_back(p - str.data());
+					for (p++; p != end && space(*p); p++)
+						;
+					return p == end;
+				case ',':
+					if (depth == 0)
+						bounds.push_back(p - str.data());
+					break;
+				}
+			}
+			return false;
+		}
+	}
+
+	// 多线程解码顶层为巨大数组的JSON: 先扫描出元素边界, 将a预先resize, 再把元素按约chunk_size
+	// 字节分组交给工作线程, 各自解码到a中对应的位置. append模式追加在已有元素之后, update模式
+	// 复用已有元素. 解析失败时返回false, 此时a的内容不确定.
+	// 所有工作线程同时从resource以及a中元素自身的polymorphic_allocator分配内存, 它们必须是
+	// 线程安全的, 如 std::pmr::synchronized_pool_resource 或 new_delete_resource();
+	// monotonic_buffer_resource, unsynchronized_pool_resource 和 memory_region 需先包一层
+	// synchronized_pool_resource.
+	template<unsigned parseFlags, class T>
+	std::enable_if_t<traits::is_resizable_random_access_v<T> && !traits::is_string_v<T>, bool>
+	from_json_string(T& a, std::string_view str, const parallel_options& options,
+		load_mode mode = load_mode::append, std::pmr::memory_resource* resource = nullptr)
+	{
+		static_assert(!(parseFlags & rapidjson::kParseInsituFlag), "in-situ parsing is not supported");
+		static_assert(!detail::is_bit_vector<T>::value,
+			"std::vector<bool> packs elements into shared words, workers cannot write them concurrently");
+
+		std::vector<std::size_t> bounds;
+		if (!detail::split_array(str, bounds))
+			return false;
+
+		auto count = bounds.size() - 1;
+		if (count == 1)
+		{
+			// "[]"中没有元素.
+			auto first = str.find_first_not_of(" \n\r\t", bounds[0] + 1);
+			if (first == bounds[1])
+				count = 0;
+		}
+
+		auto base = mode == load_mode::update ? 0 : a.size();
+		a.resize(base + count);
+
+		std::vector<std::size_t> tasks{ 0 };
+		auto chunk = (std::max)(options.chunk_size, std::size_t(1));
+		for (std::size_t k = 1; k < count; k++)
+		{
+			if (bounds[k] - bounds[tasks.back()] >= chunk)
+				tasks.push_back(k);
+		}
+		tasks.push_back(count);
+
+		auto chunks = count == 0 ? 0 : tasks.size() - 1;
+		return detail::run_parallel<char>(chunks,
+			detail::parallel_threads(options, chunks), false,
+			[&](std::size_t i, char&)
+			{
+				rapidjson::Reader reader;
+				archive::rapidjson_sax_iarchive ja(mode, resource);
+				for (auto k = tasks[i]; k < tasks[i + 1]; k++)
+				{
+					auto begin = bounds[k] + 1;
+					rapidjson::MemoryStream is(str.data() + begin, bounds[k + 1] - begin);
+					ja.reset(a[base + k]);
+					if (reader.template Parse<parseFlags>(is, ja).IsError())
+						return false;
+				}
+				return true;
+			},
+			[](std::size_t, char&&) {});
+	}
+
+	template<class T>
+	std::enable_if_t<traits::is_resizable_random_access_v<T> && !traits::is_string_v<T>, bool>
+	from_json_string(T& a, std::string_view str, const parallel_options& options,
+		load_mode mode = load_mode::append, std::pmr::memory_resource* resource = nullptr)
+	{
+		return from_json_string<rapidjson::kParseDefaultFlags>(a, str, options, mode, resource);
+	}
+
+	// 多线程解码NDJSON(JSON Lines). 输入按'\n'切分为约chunk_size字节的块,
+	// 每个工作线程将块中的记录解码到各自的T, callback(T&&)在调用线程中依次执行.
+	// 有记录解析失败时, 失败之前的记录仍会交付, 返回false.
+	template<class T, class Callback>
+	bool from_json_lines_parallel(std::string_view input, Callback&& callback,
+		const parallel_options& options = parallel_options{})
+	{
+		std::vector<std::size_t> bounds{ 0 };
+		while (bounds.back() < input.size())
+		{
+			auto pos = (std::min)(bounds.back() + (std::max)(options.chunk_size, std::size_t(1)), input.size());
+			auto nl = static_cast<const char*>(std::memchr(input.data() + pos, '\n', input.size() - pos));
+			bounds.push_back(nl ? static_cast<std::size_t>(nl - input.data()) + 1 : input.size());
+		}
+
+		auto chunks = bounds.size() - 1;
+		return detail::run_parallel<std::vector<T>>(chunks,
+			detail::parallel_threads(options, chunks), options.ordered,
+			[&](std::size_t i, std::vector<T>& records)
+			{
+				rapidjson::MemoryStream is(input.data() + bounds[i], bounds[i + 1] - bounds[i]);
+				json_lines_reader<T, rapidjson::MemoryStream> reader(is, load_mode::append);
+				for (;;)
+				{
+					T record;
+					if (!reader.read(record))
+						break;
+					records.push_back(std::move(record));
+				}
+				return !reader.error().IsError();
+			},
+			[&](std::size_t, std::vector<T>&& records)
+			{
+				for (auto& record : records)
+					callback(std::move(record));
+			});
+	}
+
+	// 多线程序列化大的顶层数组或映射: 按chunk_elements个元素切块, 每块在工作线程中
+	// 写入各自的缓冲区, 再按顺序用逗号拼接, 结果与to_json_string逐字节相同.
+	// 其它类型直接使用to_json_string.
+	template<class T>
+	void to_json_string(const T& a, std::string& str, const parallel_options& options)
+	{
+		constexpr bool is_mapping = traits::is_mapping_v<T>;
+		constexpr bool is_array = traits::has_push_back<T>() &&
+			!traits::is_string_v<T> && !std::is_same_v<std::decay_t<T>, std::wstring>;
+
+		if constexpr (!is_mapping && !is_array)
+		{
+			to_json_string(a, str);
+		}
+		else
+		{
+			std::vector<typename T::const_iterator> bounds;
+			std::size_t n = 0;
+			auto chunk = (std::max)(options.chunk_elements, std::size_t(1));
+			for (auto it = a.begin(); it != a.end(); ++it, ++n)
+			{
+				if (n % chunk == 0)
+					bounds.push_back(it);
+			}
+			bounds.push_back(a.end());
+
+			auto chunks = bounds.size() - 1;
+			str.push_back(is_mapping ? '{' : '[');
+			detail::run_parallel<std::string>(chunks,
+				detail::parallel_threads(options, chunks), true,
+				[&](std::size_t i, std::string& out)
+				{
+					archive::string_output_stream os(out);
+					archive::json_writer<archive::string_output_stream> writer(os);
+					for (auto it = bounds[i]; it != bounds[i + 1]; ++it)
+					{
+						if (it != bounds[i])
+							os.Put(',');
+						writer.Reset(os);
+						if constexpr (is_mapping)
+						{
+							// key与Writer::Key的转义相同, 冒号手动写出.
+							writer.String(it->first.c_str(), static_cast<rapidjson::SizeType>(it->first.size()));
+							os.Put(':');
+							writer.Reset(os);
+							to_json(it->second, writer);
+						}
+						else
+						{
+							to_json(*it, writer);
+						}
+					}
+					return true;
+				},
+				[&](std::size_t i, std::string&& out)
+				{
+					if (i > 0)
+						str.push_back(',');
+					str += out;
+				});
+			str.push_back(is_mapping ? '}' : ']');
+		}
+	}
+
+	template<class T>
+	std::string to_json_string(const T& a, const parallel_options& options)
+	{
+		std::string str;
+		to_json_string(a, str, options);
+		return str;
+	}
+}
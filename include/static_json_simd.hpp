@@ -0,0 +1,863 @@
+﻿//
+// Copyright (C) 2019 Jack.
+//
+// Author: jack
+// Email:  jack.wgm at gmail dot com
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <charconv>
+#include <limits>
+
+#include "static_json.hpp"
+
+// 有RAPIDJSON_DISPATCH时(x86上的GCC和clang)编译所有内核, build()时按CPU选择;
+// 否则(如MSVC)只使用编译选项已开启的指令集.
+#if defined(RAPIDJSON_DISPATCH)
+#define STATIC_JSON_TARGET(isa) RAPIDJSON_TARGET(isa)
+#define STATIC_JSON_FLATTEN __attribute__((flatten))
+#define STATIC_JSON_SIMD_SSE2
+#if defined(__x86_64__)
+// prefix_xor经64位寄存器取出PCLMULQDQ的结果.
+#define STATIC_JSON_SIMD_AVX2
+#define STATIC_JSON_SIMD_AVX512
+#endif
+#else
+#define STATIC_JSON_TARGET(isa)
+#define STATIC_JSON_FLATTEN
+#if defined(__AVX512F__) && defined(__AVX512BW__) && (defined(__PCLMUL__) || defined(_MSC_VER))
+#define STATIC_JSON_SIMD_AVX512
+#endif
+#if defined(__AVX2__) && (defined(__PCLMUL__) || defined(_MSC_VER))
+#define STATIC_JSON_SIMD_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STATIC_JSON_SIMD_SSE2
+#endif
+#endif
+
+#if defined(STATIC_JSON_SIMD_AVX2) || defined(STATIC_JSON_SIMD_AVX512)
+#include <immintrin.h>
+#elif defined(STATIC_JSON_SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace static_json {
+
+	namespace detail {
+
+		// 一个64字节块的字符分类, 每一位对应一个字节.
+		struct block_masks
+		{
+			std::uint64_t backslash;
+			std::uint64_t quote;
+			std::uint64_t op;		// {}[]:,
+			std::uint64_t space;	// 空格 \t \n \r
+		};
+
+		// 跨块携带的状态.
+		struct index_state
+		{
+			std::uint64_t prev_escaped = 0;
+			std::uint64_t prev_in_string = 0;
+			std::uint64_t prev_scalar = 0;
+		};
+
+		enum class simd_level { none, sse2, avx2, avx512 };
+
+		inline simd_level detect_simd_level()
+		{
+#if defined(RAPIDJSON_DISPATCH)
+			// AVX2和AVX-512内核还用PCLMULQDQ计算prefix_xor.
+			auto level = rapidjson::internal::GetCpuLevel();
+#if defined(STATIC_JSON_SIMD_AVX2)
+			if (level >= rapidjson::internal::kCpuAVX2 && __builtin_cpu_supports("pclmul"))
+				return level >= rapidjson::internal::kCpuAVX512 ? simd_level::avx512 : simd_level::avx2;
+#endif
+			return level >= rapidjson::internal::kCpuSSE2 ? simd_level::sse2 : simd_level::none;
+#elif defined(STATIC_JSON_SIMD_AVX512)
+			return simd_level::avx512;
+#elif defined(STATIC_JSON_SIMD_AVX2)
+			return simd_level::avx2;
+#elif defined(STATIC_JSON_SIMD_SSE2)
+			return simd_level::sse2;
+#else
+			return simd_level::none;
+#endif
+		}
+
+		// 被奇数个连续反斜杠转义的字符, prev_escaped携带跨块的状态.
+		inline std::uint64_t find_escaped(std::uint64_t backslash, std::uint64_t& prev_escaped)
+		{
+			constexpr std::uint64_t even_bits = 0x5555555555555555ULL;
+
+			backslash &= ~prev_escaped;
+			auto follows_escape = backslash << 1 | prev_escaped;
+			auto odd_starts = backslash & ~even_bits & ~follows_escape;
+			std::uint64_t even_starts;
+#if defined(_MSC_VER) && !defined(__clang__)
+			even_starts = odd_starts + backslash;
+			prev_escaped = even_starts < odd_starts;
+#else
+			prev_escaped = __builtin_add_overflow(odd_starts, backslash, &even_starts);
+#endif
+			auto invert = even_starts << 1;
+			return (even_bits ^ invert) & follows_escape;
+		}
+
+		inline int trailing_zeros(std::uint64_t x)
+		{
+#if defined(_MSC_VER) && !defined(__clang__)
+			unsigned long index;
+			_BitScanForward64(&index, x);
+			return static_cast<int>(index);
+#else
+			return __builtin_ctzll(x);
+#endif
+		}
+
+		struct scalar_kernel
+		{
+			static block_masks classify(const char* p)
+			{
+				block_masks m{ 0, 0, 0, 0 };
+				for (int i = 0; i < 64; i++)
+				{
+					auto bit = std::uint64_t(1) << i;
+					switch (p[i])
+					{
+					case '\\': m.backslash |= bit; break;
+					case '"': m.quote |= bit; break;
+					case '{': case '}': case '[': case ']': case ':': case ',': m.op |= bit; break;
+					case ' ': case '\t': case '\n': case '\r': m.space |= bit; break;
+					}
+				}
+				return m;
+			}
+
+			// 每一位为该位及之前所有位的异或, 即引号之间(含开引号)为1.
+			static std::uint64_t prefix_xor(std::uint64_t x)
+			{
+				x ^= x << 1;
+				x ^= x << 2;
+				x ^= x << 4;
+				x ^= x << 8;
+				x ^= x << 16;
+				x ^= x << 32;
+				return x;
+			}
+		};
+
+#if defined(STATIC_JSON_SIMD_SSE2)
+		struct sse2_kernel
+		{
+			STATIC_JSON_TARGET("sse2") static __m128i eq(__m128i v, char c)
+			{
+				return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+			}
+
+			STATIC_JSON_TARGET("sse2") static block_masks classify(const char* p)
+			{
+				block_masks m{ 0, 0, 0, 0 };
+				for (int i = 0; i < 4; i++)
+				{
+					auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 16));
+					auto op = _mm_or_si128(_mm_or_si128(_mm_or_si128(eq(v, '{'), eq(v, '}')), _mm_or_si128(eq(v, '['), eq(v, ']'))),
+						_mm_or_si128(eq(v, ':'), eq(v, ',')));
+					auto space = _mm_or_si128(_mm_or_si128(eq(v, ' '), eq(v, '\t')), _mm_or_si128(eq(v, '\n'), eq(v, '\r')));
+					auto shift = i * 16;
+					m.backslash |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(eq(v, '\\')))) << shift;
+					m.quote |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(eq(v, '"')))) << shift;
+					m.op |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(op))) << shift;
+					m.space |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(space))) << shift;
+				}
+				return m;
+			}
+
+			static std::uint64_t prefix_xor(std::uint64_t x)
+			{
+				return scalar_kernel::prefix_xor(x);
+			}
+		};
+#endif
+
+#if defined(STATIC_JSON_SIMD_AVX2)
+		struct avx2_kernel
+		{
+			STATIC_JSON_TARGET("avx2") static __m256i eq(__m256i v, char c)
+			{
+				return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+			}
+
+			STATIC_JSON_TARGET("avx2") static std::uint64_t movemask(__m256i lo, __m256i hi)
+			{
+				auto l = static_cast<std::uint32_t>(_mm256_movemask_epi8(lo));
+				auto h = static_cast<std::uint32_t>(_mm256_movemask_epi8(hi));
+				return l | (std::uint64_t(h) << 32);
+			}
+
+			STATIC_JSON_TARGET("avx2") static __m256i op(__m256i v)
+			{
+				return _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(eq(v, '{'), eq(v, '}')), _mm256_or_si256(eq(v, '['), eq(v, ']'))),
+					_mm256_or_si256(eq(v, ':'), eq(v, ',')));
+			}
+
+			STATIC_JSON_TARGET("avx2") static __m256i space(__m256i v)
+			{
+				return _mm256_or_si256(_mm256_or_si256(eq(v, ' '), eq(v, '\t')), _mm256_or_si256(eq(v, '\n'), eq(v, '\r')));
+			}
+
+			STATIC_JSON_TARGET("avx2") static block_masks classify(const char* p)
+			{
+				auto lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+				auto hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+				return {
+					movemask(eq(lo, '\\'), eq(hi, '\\')),
+					movemask(eq(lo, '"'), eq(hi, '"')),
+					movemask(op(lo), op(hi)),
+					movemask(space(lo), space(hi))
+				};
+			}
+
+			STATIC_JSON_TARGET("pclmul") static std::uint64_t prefix_xor(std::uint64_t x)
+			{
+				return static_cast<std::uint64_t>(_mm_cvtsi128_si64(_mm_clmulepi64_si128(
+					_mm_set_epi64x(0, static_cast<long long>(x)), _mm_set1_epi8(-1), 0)));
+			}
+		};
+#endif
+
+#if defined(STATIC_JSON_SIMD_AVX512)
+		struct avx512_kernel
+		{
+			STATIC_JSON_TARGET("avx512f,avx512bw") static std::uint64_t eq(__m512i v, char c)
+			{
+				return _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(c));
+			}
+
+			STATIC_JSON_TARGET("avx512f,avx512bw") static block_masks classify(const char* p)
+			{
+				auto v = _mm512_loadu_si512(reinterpret_cast<const void*>(p));
+				return {
+					eq(v, '\\'),
+					eq(v, '"'),
+					eq(v, '{') | eq(v, '}') | eq(v, '[') | eq(v, ']') | eq(v, ':') | eq(v, ','),
+					eq(v, ' ') | eq(v, '\t') | eq(v, '\n') | eq(v, '\r')
+				};
+			}
+
+			STATIC_JSON_TARGET("pclmul") static std::uint64_t prefix_xor(std::uint64_t x)
+			{
+				return static_cast<std::uint64_t>(_mm_cvtsi128_si64(_mm_clmulepi64_si128(
+					_mm_set_epi64x(0, static_cast<long long>(x)), _mm_set1_epi8(-1), 0)));
+			}
+		};
+#endif
+
+		// 索引p开始的size字节(64的倍数), base为p在输入中的偏移. 结构字符, 开引号和标量起始
+		// 的位置依次写入out, out须还能容纳size个位置, 返回写入后的末尾.
+		template<class Kernel>
+		inline std::uint32_t* find_structurals(const char* p, std::size_t size, std::size_t base,
+			std::uint32_t* out, index_state& s)
+		{
+			for (std::size_t offset = 0; offset < size; offset += 64)
+			{
+				auto m = Kernel::classify(p + offset);
+				auto quote = m.quote & ~find_escaped(m.backslash, s.prev_escaped);
+				auto in_string = Kernel::prefix_xor(quote) ^ s.prev_in_string;
+				s.prev_in_string = static_cast<std::uint64_t>(static_cast<std::int64_t>(in_string) >> 63);
+
+				auto scalar = ~(m.op | m.space | quote);
+				auto scalar_start = scalar & ~(scalar << 1 | s.prev_scalar);
+				s.prev_scalar = scalar >> 63;
+
+				// 去掉字符串内容和闭引号, 保留开引号.
+				auto bits = (m.op | quote | scalar_start) & ~(in_string ^ quote);
+				auto at = static_cast<std::uint32_t>(base + offset);
+				while (bits)
+				{
+					*out++ = at + detail::trailing_zeros(bits);
+					bits &= bits - 1;
+				}
+			}
+			return out;
+		}
+
+		// 每个指令集一个完整的循环, 内核函数带有target属性, 须flatten才能内联进来.
+#if defined(STATIC_JSON_SIMD_SSE2)
+		STATIC_JSON_TARGET("sse2") STATIC_JSON_FLATTEN inline std::uint32_t* find_structurals_sse2(const char* p, std::size_t size,
+			std::size_t base, std::uint32_t* out, index_state& s)
+		{
+			return find_structurals<sse2_kernel>(p, size, base, out, s);
+		}
+#endif
+
+#if defined(STATIC_JSON_SIMD_AVX2)
+		STATIC_JSON_TARGET("avx2,pclmul") STATIC_JSON_FLATTEN inline std::uint32_t* find_structurals_avx2(const char* p, std::size_t size,
+			std::size_t base, std::uint32_t* out, index_state& s)
+		{
+			return find_structurals<avx2_kernel>(p, size, base, out, s);
+		}
+#endif
+
+#if defined(STATIC_JSON_SIMD_AVX512)
+		STATIC_JSON_TARGET("avx512f,avx512bw,pclmul") STATIC_JSON_FLATTEN inline std::uint32_t* find_structurals_avx512(const char* p,
+			std::size_t size, std::size_t base, std::uint32_t* out, index_state& s)
+		{
+			return find_structurals<avx512_kernel>(p, size, base, out, s);
+		}
+#endif
+
+		inline std::uint32_t* find_structurals(simd_level level, const char* p, std::size_t size,
+			std::size_t base, std::uint32_t* out, index_state& s)
+		{
+			switch (level)
+			{
+#if defined(STATIC_JSON_SIMD_AVX512)
+			case simd_level::avx512: return find_structurals_avx512(p, size, base, out, s);
+#endif
+#if defined(STATIC_JSON_SIMD_AVX2)
+			case simd_level::avx2: return find_structurals_avx2(p, size, base, out, s);
+#endif
+#if defined(STATIC_JSON_SIMD_SSE2)
+			case simd_level::sse2: return find_structurals_sse2(p, size, base, out, s);
+#endif
+			default: return find_structurals<scalar_kernel>(p, size, base, out, s);
+			}
+		}
+
+		inline const char* scan_string_scalar(const char* p, const char* end)
+		{
+			while (p != end && *p != '"' && *p != '\\' && static_cast<unsigned char>(*p) >= 0x20)
+				p++;
+			return p;
+		}
+
+#if defined(STATIC_JSON_SIMD_SSE2)
+		STATIC_JSON_TARGET("sse2") inline const char* scan_string_sse2(const char* p, const char* end)
+		{
+			const auto quote = _mm_set1_epi8('"');
+			const auto backslash = _mm_set1_epi8('\\');
+			const auto control = _mm_set1_epi8(0x1F);
+			for (; end - p >= 16; p += 16)
+			{
+				auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+				auto x = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+					_mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+				auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(x));
+				if (mask)
+					return p + trailing_zeros(mask);
+			}
+			return scan_string_scalar(p, end);
+		}
+#endif
+
+#if defined(STATIC_JSON_SIMD_AVX2)
+		STATIC_JSON_TARGET("avx2") inline const char* scan_string_avx2(const char* p, const char* end)
+		{
+			const auto quote = _mm256_set1_epi8('"');
+			const auto backslash = _mm256_set1_epi8('\\');
+			const auto control = _mm256_set1_epi8(0x1F);
+			for (; end - p >= 32; p += 32)
+			{
+				auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+				auto x = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+					_mm256_cmpeq_epi8(_mm256_max_epu8(v, control), control));
+				auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(x));
+				if (mask)
+					return p + trailing_zeros(mask);
+			}
+			return scan_string_scalar(p, end);
+		}
+#endif
+
+		// 跳到第一个引号, 反斜杠或控制字符.
+		inline const char* scan_string(simd_level level, const char* p, const char* end)
+		{
+			switch (level)
+			{
+#if defined(STATIC_JSON_SIMD_AVX2)
+			case simd_level::avx512:
+			case simd_level::avx2: return scan_string_avx2(p, end);
+#endif
+#if defined(STATIC_JSON_SIMD_SSE2)
+			case simd_level::sse2: return scan_string_sse2(p, end);
+#endif
+			default: return scan_string_scalar(p, end);
+			}
+		}
+
+		inline bool is_scalar_char(char c)
+		{
+			switch (c)
+			{
+			case '{': case '}': case '[': case ']': case ':': case ',': case '"':
+			case ' ': case '\t': case '\n': case '\r':
+				return false;
+			}
+			return true;
+		}
+
+		inline bool is_digit(char c)
+		{
+			return c >= '0' && c <= '9';
+		}
+	}
+
+	// 两阶段解析: build()以SIMD逐64字节计算转义, 字符串内外和结构字符, 得到所有结构字符,
+	// 开引号以及标量(数字, true, false, null)起始位置的索引; parse()沿索引驱动SAX handler,
+	// 事件与rapidjson::Reader使用kParseFullPrecisionFlag时一致. 同一个索引可重复使用以复用内存.
+	// 指令集在build()时按CPU选择(AVX-512, AVX2, SSE2), 与rapidjson一样受SetCpuLevel限制.
+	class structural_index
+	{
+	public:
+		// 输入不超过4GB, 字符串未闭合时返回false.
+		bool build(std::string_view json)
+		{
+			json_ = json;
+			count_ = 0;
+			level_ = detail::detect_simd_level();
+			if (json.size() >= (std::numeric_limits<std::uint32_t>::max)())
+				return false;
+
+			// 每段之前保证positions_还能容纳该段的字节数, 内核中不必检查容量.
+			constexpr std::size_t segment = 64 * 1024;
+			detail::index_state state;
+			auto full = json.size() / 64 * 64;
+			for (std::size_t base = 0; base < full; base += segment)
+			{
+				auto size = (std::min)(segment, full - base);
+				reserve(size);
+				auto out = detail::find_structurals(level_, json.data() + base, size, base,
+					positions_.data() + count_, state);
+				count_ = out - positions_.data();
+			}
+
+			if (full != json.size())
+			{
+				char tail[64];
+				std::memset(tail, ' ', sizeof(tail));
+				std::memcpy(tail, json.data() + full, json.size() - full);
+				reserve(sizeof(tail));
+				auto out = detail::find_structurals(level_, tail, sizeof(tail), full,
+					positions_.data() + count_, state);
+				count_ = out - positions_.data();
+			}
+
+			return state.prev_in_string == 0;
+		}
+
+		std::size_t size() const
+		{
+			return count_;
+		}
+
+		const std::uint32_t* positions() const
+		{
+			return positions_.data();
+		}
+
+		// 按索引解析build()时的输入, 语法错误或handler返回false时返回false.
+		template<class Handler>
+		bool parse(Handler& handler)
+		{
+			const auto* buf = json_.data();
+			const auto* pos = positions_.data();
+			const std::size_t n = count_;
+			std::size_t i = 0;
+
+			auto peek = [&]() -> char { return i < n ? buf[pos[i]] : '\0'; };
+			auto key = [&]() -> bool
+			{
+				if (peek() != '"' || !string(pos[i++], handler, true) || peek() != ':')
+					return false;
+				return ++i < n;
+			};
+
+			stack_.clear();
+			if (n == 0)
+				return false;
+
+			for (;;)
+			{
+				auto at = pos[i++];
+				switch (buf[at])
+				{
+				case '{':
+					if (!handler.StartObject())
+						return false;
+					if (peek() == '}')
+					{
+						i++;
+						if (!handler.EndObject(0))
+							return false;
+						break;
+					}
+					stack_.push_back({ true, 0 });
+					if (!key())
+						return false;
+					continue;
+				case '[':
+					if (!handler.StartArray())
+						return false;
+					if (peek() == ']')
+					{
+						i++;
+						if (!handler.EndArray(0))
+							return false;
+						break;
+					}
+					stack_.push_back({ false, 0 });
+					if (i >= n)
+						return false;
+					continue;
+				case '"':
+					if (!string(at, handler, false))
+						return false;
+					break;
+				default:
+					if (!scalar(at, i < n ? pos[i] : json_.size(), handler))
+						return false;
+					break;
+				}
+
+				// 一个值结束, 依次关闭已完成的容器.
+				for (;;)
+				{
+					if (stack_.empty())
+						return i == n;
+
+					auto& s = stack_.back();
+					s.count++;
+					auto c = peek();
+					i++;
+					if (c == ',')
+					{
+						if (s.object ? !key() : i >= n)
+							return false;
+						break;
+					}
+					if (c != (s.object ? '}' : ']'))
+						return false;
+
+					auto count = s.count;
+					auto object = s.object;
+					stack_.pop_back();
+					if (!(object ? handler.EndObject(count) : handler.EndArray(count)))
+						return false;
+				}
+			}
+		}
+
+	private:
+		void reserve(std::size_t n)
+		{
+			if (positions_.size() < count_ + n)
+				positions_.resize((std::max)(positions_.size() * 2, count_ + n));
+		}
+
+		static bool hex4(const char* p, unsigned& codepoint)
+		{
+			codepoint = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				auto c = p[i];
+				codepoint <<= 4;
+				if (c >= '0' && c <= '9')
+					codepoint |= c - '0';
+				else if (c >= 'a' && c <= 'f')
+					codepoint |= c - 'a' + 10;
+				else if (c >= 'A' && c <= 'F')
+					codepoint |= c - 'A' + 10;
+				else
+					return false;
+			}
+			return true;
+		}
+
+		void put_utf8(unsigned codepoint)
+		{
+			auto& out = string_buffer_;
+			if (codepoint < 0x80)
+			{
+				out.push_back(static_cast<char>(codepoint));
+			}
+			else if (codepoint < 0x800)
+			{
+				out.push_back(static_cast<char>(0xC0 | (codepoint >> 6)));
+				out.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+			}
+			else if (codepoint < 0x10000)
+			{
+				out.push_back(static_cast<char>(0xE0 | (codepoint >> 12)));
+				out.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+				out.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+			}
+			else
+			{
+				out.push_back(static_cast<char>(0xF0 | (codepoint >> 18)));
+				out.push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
+				out.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+				out.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+			}
+		}
+
+		// at为开引号位置. 没有转义时直接交出原文, 否则解码到string_buffer_.
+		template<class Handler>
+		bool string(std::size_t at, Handler& handler, bool is_key)
+		{
+			auto p = json_.data() + at + 1;
+			auto end = json_.data() + json_.size();
+			auto start = p;
+			p = detail::scan_string(level_, p, end);
+
+			const char* str = start;
+			if (p != end && *p == '\\')
+			{
+				string_buffer_.assign(start, p);
+				while (p != end && *p == '\\')
+				{
+					if (++p == end)
+						return false;
+					switch (*p++)
+					{
+					case '"': string_buffer_.push_back('"'); break;
+					case '\\': string_buffer_.push_back('\\'); break;
+					case '/': string_buffer_.push_back('/'); break;
+					case 'b': string_buffer_.push_back('\b'); break;
+					case 'f': string_buffer_.push_back('\f'); break;
+					case 'n': string_buffer_.push_back('\n'); break;
+					case 'r': string_buffer_.push_back('\r'); break;
+					case 't': string_buffer_.push_back('\t'); break;
+					case 'u':
+					{
+						unsigned codepoint;
+						if (end - p < 4 || !hex4(p, codepoint))
+							return false;
+						p += 4;
+						if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+						{
+							unsigned low;
+							if (end - p < 6 || p[0] != '\\' || p[1] != 'u' || !hex4(p + 2, low) ||
+								low < 0xDC00 || low > 0xDFFF)
+								return false;
+							p += 6;
+							codepoint = (((codepoint - 0xD800) << 10) | (low - 0xDC00)) + 0x10000;
+						}
+						put_utf8(codepoint);
+						break;
+					}
+					default:
+						return false;
+					}
+
+					auto run = p;
+					p = detail::scan_string(level_, p, end);
+					string_buffer_.append(run, p);
+				}
+				str = string_buffer_.data();
+				start = nullptr;
+			}
+			if (p == end || *p != '"')
+				return false;
+
+			auto length = static_cast<rapidjson::SizeType>(start ? p - start : string_buffer_.size());
+			return is_key ? handler.Key(str, length, true) : handler.String(str, length, true);
+		}
+
+		// 按JSON的数字语法校验并累加尾数, 整数的类型选择与rapidjson::Reader相同. 浮点数
+		// 按正确舍入转换, 与kParseFullPrecisionFlag一致: 尾数不超过2^53且10的指数不超过22时
+		// 一次乘除即是精确结果, 其余交给std::from_chars.
+		// next为下一个索引位置, 标量在它之前结束.
+		template<class Handler>
+		bool scalar(std::size_t at, std::size_t next, Handler& handler)
+		{
+			auto p = json_.data() + at;
+			auto q = json_.data() + next;
+			while (q != p && !detail::is_scalar_char(q[-1]))
+				q--;
+			if (q == p)
+				return false;
+
+			std::string_view token(p, q - p);
+			switch (*p)
+			{
+			case 't': return token == "true" && handler.Bool(true);
+			case 'f': return token == "false" && handler.Bool(false);
+			case 'n': return token == "null" && handler.Null();
+			}
+
+			auto s = p;
+			bool minus = *s == '-';
+			if (minus)
+				s++;
+			if (s == q || !detail::is_digit(*s))
+				return false;
+
+			// 整数部分, 超出uint64时只能作为浮点数.
+			std::uint64_t u = 0;
+			bool overflow = false;
+			int int_digits = 0;
+			if (*s == '0')
+			{
+				s++;
+			}
+			else
+			{
+				for (; s != q && detail::is_digit(*s); s++, int_digits++)
+				{
+					unsigned d = *s - '0';
+					if (u > ((std::numeric_limits<std::uint64_t>::max)() - d) / 10)
+						overflow = true;
+					else if (!overflow)
+						u = u * 10 + d;
+				}
+			}
+
+			// 尾数最多累加19位有效数字, 多出的位使exact为false.
+			bool integer = true;
+			bool exact = int_digits <= 19;
+			int significant = int_digits;
+			int scale = 0;
+			int frac_zeros = 0;
+			int frac_digits = 0;
+			if (s != q && *s == '.')
+			{
+				integer = false;
+				if (++s == q || !detail::is_digit(*s))
+					return false;
+				auto digits = s;
+				for (; s != q && *s == '0'; s++)
+				{
+					if (significant)
+						significant++;
+				}
+				frac_zeros = static_cast<int>(s - digits);
+				for (; s != q && detail::is_digit(*s); s++)
+				{
+					if (++significant > 19)
+						exact = false;
+				}
+				frac_digits = static_cast<int>(s - digits);
+
+				if (exact)
+				{
+					for (auto c = digits; c != s; c++)
+						u = u * 10 + (*c - '0');
+					scale = -frac_digits;
+				}
+			}
+
+			int exp = 0;
+			if (s != q && (*s == 'e' || *s == 'E'))
+			{
+				integer = false;
+				bool exp_minus = false;
+				if (++s != q && (*s == '+' || *s == '-'))
+					exp_minus = *s++ == '-';
+				if (s == q || !detail::is_digit(*s))
+					return false;
+				for (; s != q && detail::is_digit(*s); s++)
+				{
+					if (exp < 100000000)
+						exp = exp * 10 + (*s - '0');
+				}
+				if (exp_minus)
+					exp = -exp;
+
+				// 与rapidjson::Reader一致, 尾数为0时过大的指数也是错误.
+				if (int_digits == 0 && frac_zeros == frac_digits && exp > 308 + frac_digits)
+					return false;
+			}
+
+			if (s != q)
+				return false;
+
+			if (integer && !overflow)
+			{
+				if (minus)
+				{
+					if (u <= 0x80000000u)
+						return handler.Int(static_cast<int>(~static_cast<std::uint32_t>(u) + 1));
+					if (u <= 0x8000000000000000u)
+						return handler.Int64(static_cast<std::int64_t>(~u + 1));
+				}
+				else
+				{
+					if (u <= 0xFFFFFFFFu)
+						return handler.Uint(static_cast<unsigned>(u));
+					return handler.Uint64(u);
+				}
+			}
+
+			static constexpr double pow10[] = {
+				1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+				1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+			};
+			auto e10 = scale + exp;
+			if (exact && u <= (std::uint64_t(1) << 53) && e10 >= -22 && e10 <= 22)
+			{
+				auto d = static_cast<double>(u);
+				d = e10 < 0 ? d / pow10[-e10] : d * pow10[e10];
+				return handler.Double(minus ? -d : d);
+			}
+
+#if defined(__cpp_lib_to_chars)
+			double d;
+			auto result = std::from_chars(p, q, d);
+			if (result.ec == std::errc::result_out_of_range)
+			{
+				// 上溢是错误, 下溢得到0, 按首个有效数字的十进制位置区分.
+				auto magnitude = int_digits ? int_digits + exp : exp - frac_zeros;
+				if (magnitude > 0)
+					return false;
+				d = minus ? -0.0 : 0.0;
+			}
+			else if (result.ec != std::errc() || result.ptr != q)
+			{
+				return false;
+			}
+			return handler.Double(d);
+#else
+			rapidjson::MemoryStream is(p, q - p);
+			return !number_reader_.Parse<rapidjson::kParseFullPrecisionFlag>(is, handler).IsError();
+#endif
+		}
+
+		struct scope
+		{
+			bool object;
+			rapidjson::SizeType count;
+		};
+
+		std::string_view json_;
+		std::vector<std::uint32_t> positions_;
+		std::size_t count_ = 0;
+		std::vector<scope> stack_;
+		std::string string_buffer_;
+		detail::simd_level level_ = detail::simd_level::none;
+#if !defined(__cpp_lib_to_chars)
+		rapidjson::Reader number_reader_;
+#endif
+	};
+
+	// 使用结构索引两阶段解析str到a, index可在多次调用间复用.
+	// 以SIMD跳过字符串内容取胜, 适合长字符串多的文档; 数字密集时不如from_json_string快.
+	template<class T>
+	bool from_json_string(T& a, std::string_view str, structural_index& index,
+		load_mode mode = load_mode::append, std::pmr::memory_resource* resource = nullptr)
+	{
+		if (!index.build(str))
+			return false;
+
+		archive::rapidjson_sax_iarchive ja(a, mode, resource);
+		return index.parse(ja);
+	}
+}
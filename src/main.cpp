@@ -8,6 +8,9 @@
 #include <iostream>
 #include <list>
 #include "static_json.hpp"
+#include "static_json_parallel.hpp"
+#include "static_json_simd.hpp"
+#include "static_json_mmap.hpp"
 
 using namespace static_json;
 
@@ -48,11 +51,11 @@ public:
 #endif
 
 private:
-	int64_t age;
-	int legs;
-	bool is_mammal;
+	int64_t age = 0;
+	int legs = 0;
+	bool is_mammal = false;
 	std::string name;
-	double height;
+	double height = 0;
 	std::vector<std::string> game;
 };
 
@@ -165,7 +168,7 @@ private:
 			& JSON_SERIALIZATION_NVP(man);
 	}
 
-	bool can_fly;
+	bool can_fly = false;
 	std::vector<animal> fat;
 	std::vector<int> money;
 	human man;
@@ -178,21 +181,21 @@ std::ostream& operator<< (std::ostream& stream, const bird& b)
 			<< " fat: [";
 	for (const auto& f : b.fat)
 		stream << f;
-		stream
-			<< "]"
-			<< " money: [";
+	stream
+		<< "]"
+		<< " money: [";
 	for (const auto& m : b.money)
 		stream << "[" << m << "]";
-		stream
-			<< "]"
-			<< " man: " << b.man
-			<< "]";
+	stream
+		<< "]"
+		<< " man: " << b.man
+		<< "]";
 	return stream;
 }
 
 int main()
 {
-	rapidjson::Value json{ rapidjson::kObjectType };
+	rapidjson::Document json{ rapidjson::kObjectType };
 
 	{
 		std::vector<animal> animals;
@@ -243,8 +246,8 @@ int main()
 	}
 
 	// 清空一下json, 用于下面测试.
-	rapidjson::Value empty{ rapidjson::kObjectType };
-	json.Swap(empty);
+	json.SetObject();
+	json.GetAllocator().Clear();
 
 	{
 		bird c(4, true);
@@ -279,9 +282,90 @@ int main()
 
 		std::cout << "string -> animal: " << a << std::endl;
 
+		// 使用SIMD结构索引的两阶段解析.
+		structural_index index;
+		animal b;
+		from_json_string(b, json_str, index);
+
+		std::cout << "string -> animal (indexed): " << b << std::endl;
+
+		// 校验字符串为合法UTF-8.
+		animal c;
+		bool valid = from_json_string<rapidjson::kParseValidateEncodingFlag>(c, json_str);
+
+		std::cout << "string -> animal (utf-8 validated): " << valid << std::endl;
+
+		// 复用当前线程的解析上下文.
+		animal d;
+		from_json_string(d, json_str, thread_parse_context());
+
+		std::cout << "string -> animal (thread context): " << d << std::endl;
+
+		// 模拟分块到达的数据, 边收边解码.
+		animal e;
+		json_push_parser<> parser(e);
+		std::string_view input(json_str);
+		for (std::size_t pos = 0; pos < input.size(); pos += 8)
+			parser.feed(input.substr(pos, 8));
+		bool done = parser.finish() == parse_status::done;
+
+		std::cout << "chunks -> animal (" << done << "): " << e << std::endl;
+
 		std::cout << "animal -> string: " << to_json_string(a) << std::endl;
 	}
 
+	// 在预先保留的大页内存中构建json对象.
+	{
+		memory_region region(64 * 1024 * 1024);
+		rapidjson::Document doc(&region.allocator());
+
+		animal a;
+		a.set_age(1000234234235);
+		a.set_name("Horse");
+		a.set_leg(4);
+		a.set_ismammal(true);
+		a.set_height(9.83);
+		a.set_game();
+		to_json(a, doc);
+
+		animal b;
+		from_json(b, doc, load_mode::append, &region);
+
+		std::cout << "animal -> region (" << region.used() << " bytes): " << b << std::endl;
+
+		// 写入文件, 再映射文件解码.
+		auto path = std::filesystem::temp_directory_path() / "static_json_animal.json";
+		to_json_file(a, path);
+
+		animal c;
+		from_json_file(c, path);
+		std::filesystem::remove(path);
+
+		std::cout << "file -> animal: " << c << std::endl;
+	}
+
+	// NDJSON(JSON Lines), 多线程解码.
+	{
+		std::string lines;
+		json_lines_writer writer(lines);
+		for (int i = 0; i < 3; i++)
+		{
+			animal a;
+			a.set_age(i);
+			a.set_name("Horse");
+			a.set_leg(4);
+			a.set_ismammal(true);
+			a.set_height(9.83);
+			writer.write(a);
+		}
+
+		std::cout << "animals -> ndjson: " << lines;
+
+		from_json_lines_parallel<animal>(lines, [](animal&& a) {
+			std::cout << "ndjson -> animal: " << a << std::endl;
+		});
+	}
+
 	return 0;
 }
 